@@ -13,22 +13,134 @@
 #include <unistd.h> // read, write, close
 #include <sys/uio.h> // writev
 #include <stdexcept> // stoi exceptions
-
+#include <vector> // vector
+#include <cerrno> // errno
+#include <cstdlib> // mkstemp
+#include <fcntl.h> // vmsplice, splice
+#include <poll.h> // poll
+#include <sys/sendfile.h> // sendfile
+#include <linux/errqueue.h> // sock_extended_err
+#include "Protocol.h" // write types, TestHeader
+#include "Latency.h" // LatencyStats, monotonicNs
+#include "TcpInfo.h" // TcpInfoSampler
+#include "SocketOptions.h" // SocketOptions, setCork
+#include "Transport.h" // Transport, Connection
+#include "CpuCost.h" // CpuCost
+#include <pthread.h> // pthread_create, pthread_barrier_t
+#include <fstream> // ofstream
+#include <cmath> // sqrt
+#include <climits> // IOV_MAX
+#include <algorithm> // min, max
+
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
 
 using namespace std;
 
-// write types
-const int MULTIPLE_WRITES = 1;
-const int WRITEV = 2;
-const int SINGLE_WRITE = 3;
+const char *TMPFS_TEMPLATE = "/dev/shm/hw1-sendfile-XXXXXX"; // backing file for sendfile
 const int BUFSIZE = 1500; // cumulative size of all data buffers (nbufs * bufsize)
+const int SEQPACKET_MAX_RECORD = 64 * 1024; // a seqpacket record must fit the send buffer
+
+// sweep mode (-S): message sizes 64 B to 4 MB, doubling
+const int SWEEP_MIN_SIZE = 64;
+const int SWEEP_MAX_SIZE = 4 * 1024 * 1024;
+const int SWEEP_SPLITS[] = { 1, 8, 64, 512 }; // nbufs tried for the split write types
+const long SWEEP_BYTES = 64L * 1024 * 1024; // cap on bytes moved by one run
+
+// matrix mode (-M): every combination of these socket option values
+const int MATRIX_NODELAY[] = { 0, 1 };
+const int MATRIX_CORK[] = { CORK_OFF, CORK_TCP, CORK_MSG_MORE };
+const int MATRIX_SNDBUF[] = { -1, 256 * 1024 };
+const int MATRIX_RCVBUF[] = { -1, 256 * 1024 };
+const int MATRIX_NOTSENT_LOWAT[] = { -1, 16 * 1024 };
+const int MATRIX_BUSY_POLL[] = { -1, 50 };
 
 int serverPort; // server's port number
 char *serverName; // server's IP address or hostname
 int repetition; // the number of iterations a client performs on data transmission using write type
 int nbufs; // number of data buffers
 int bufsize; // size of each data biffer
-int type; // the type of transfer scenario: 1, 2, or 3
+int type; // the type of transfer scenario: 1 to 6
+string dumpPath; // -d: file for raw per-iteration latency samples
+int streams = 1; // -P: number of parallel connections, one thread each
+int infoInterval = 0; // -i: TCP_INFO sampling interval in ms, 0 = off
+string sweepName; // -S: run the parameter sweep, write <name>.csv and <name>.json
+int warmups = 1; // -W: discarded runs before each sweep point
+int runs = 5; // -R: measured runs per sweep point
+SocketOptions sockOpts; // -N, -C, -s, -b, -L, -B
+string matrixName; // -M: run the socket option matrix, write <name>.csv and <name>.json
+int echoSize = 0; // -E: echo mode, bytes the server replies to each message; 0 = off
+int depth = 1; // -D: echo mode, requests kept outstanding (pipelining)
+string transportName = "tcp"; // -T: tcp, unix, seqpacket or shm
+Transport *transport; // made from transportName in main
+
+vector<char> message; // persistent message buffer for the zero-copy types (read only)
+pthread_barrier_t startBarrier; // releases all streams at the same moment
+
+// Stream is one connection to the server and everything measured on it.
+// Each parallel stream runs on its own thread and owns its Stream.
+struct Stream {
+    int id; // 0 .. streams - 1
+    Connection *conn; // connection to the server
+    int sd; // conn's socket descriptor, -1 for the shared-memory ring
+    bool ok; // connected and completed the test
+    int spliceFds[2]; // pipe used by vmsplice/splice
+    int tmpfsFd; // tmpfs file used by sendfile
+
+    // MSG_ZEROCOPY accounting
+    long zcSends; // send( ) calls issued with MSG_ZEROCOPY
+    long zcCompleted; // sends whose completion has been reaped
+    long zcCopied; // completions where the kernel fell back to copying
+    long zcNoBufs; // sends that failed with ENOBUFS (optmem exhausted)
+
+    LatencyStats latency; // time of each repetition (round trip in echo mode)
+    struct timeval start, lap, stop; // test start, writes done, server replied
+    int numReads; // server's read( ) count
+    TcpInfoSampler tcpInfo; // TCP_INFO time series for this connection
+    CpuCost cpu; // counters for this stream's thread during the test
+    long ioCalls; // I/O system calls made by the test, for syscalls/message
+
+    explicit Stream(int id) : id(id), conn(nullptr), sd(-1), ok(false), tmpfsFd(-1), zcSends(0),
+        zcCompleted(0), zcCopied(0), zcNoBufs(0), latency(!dumpPath.empty()), numReads(0), ioCalls(0) {
+        spliceFds[0] = spliceFds[1] = -1;
+    }
+};
+
+// maxType returns the highest write type the transport supports. The
+// zero-copy types need a TCP socket; the first three run on any Connection.
+int maxType() {
+    return transportName == "tcp" ? NUM_TYPES : SINGLE_WRITE;
+}
+
+// readSysctl returns field (counting from 0) of the /proc/sys file at
+// path, 0 if it cannot be read
+long readSysctl(const char *path, int field) {
+    ifstream in(path);
+    long value = 0;
+    for (int i = 0; i <= field; i++) {
+        if (!(in >> value)) return 0;
+    }
+    return value;
+}
+
+// echoBufferBytes is how many bytes of requests and replies a connection
+// buffers: the client's send buffer plus the server's receive buffer, from
+// -s and -b or the kernel defaults, or the shm ring. 0 if unknown.
+long echoBufferBytes() {
+    if (transportName == "shm") return SHM_RING_SIZE;
+    bool tcp = transportName == "tcp";
+    long sndbuf = sockOpts.sndbuf > 0 ? sockOpts.sndbuf
+                : tcp ? readSysctl("/proc/sys/net/ipv4/tcp_wmem", 1)
+                : readSysctl("/proc/sys/net/core/wmem_default", 0);
+    long rcvbuf = sockOpts.rcvbuf > 0 ? sockOpts.rcvbuf
+                : tcp ? readSysctl("/proc/sys/net/ipv4/tcp_rmem", 1)
+                : readSysctl("/proc/sys/net/core/rmem_default", 0);
+    return (sndbuf > 0 && rcvbuf > 0) ? sndbuf + rcvbuf : 0;
+}
 
 // validates the 6 arguments passed into main
 // return true if all are valid, false otherwise
@@ -68,60 +180,361 @@ bool validateArgs(char *args[]) {
         return false;
     }
 
-    // Total buffsize should be 1500
-    if (nbufs * bufsize != BUFSIZE)
+    // Total buffsize should be 1500 (the sweep picks its own sizes and echo
+    // mode takes any request size)
+    if (sweepName.empty() && echoSize == 0 && nbufs * bufsize != BUFSIZE)
     {
         cout << "Number of buffers times buffer size does not equal" 
         + to_string(BUFSIZE) << endl;
         return false;
     }
 
-    if (type < 1 || type > 3)
+    if (echoSize > 0 && nbufs * bufsize <= 0)
     {
-        cout << "Type must be between 1 and 3" << endl;
+        cout << "Echo requests must be at least 1 byte" << endl;
+        return false;
+    }
+
+    // the server does not read while its reply write blocks, so a pipeline
+    // holding more than the buffers can deadlock both sides
+    long transaction = (long) nbufs * bufsize + echoSize;
+    long buffers = echoBufferBytes();
+    if (echoSize > 0 && depth > 1 && buffers > 0 && depth * transaction > buffers)
+    {
+        cout << "Pipeline depth " + to_string(depth) + " keeps "
+            + to_string(depth * transaction) + " bytes in flight, more than the "
+            + to_string(buffers) + " bytes of socket buffers; use -D "
+            + to_string(max(1L, buffers / transaction)) + " or less" << endl;
+        return false;
+    }
+
+    if (type < 1 || type > maxType())
+    {
+        cout << "Type must be between 1 and " + to_string(maxType())
+            + " with the " + transportName + " transport" << endl;
+        return false;
+    }
+
+    // each write is one seqpacket record: writev and single-write send the
+    // whole message at once, and the server sends each echo reply at once
+    int record = max(type == MULTIPLE_WRITES ? bufsize : nbufs * bufsize, echoSize);
+    if (transportName == "seqpacket" && (record > SEQPACKET_MAX_RECORD || !sweepName.empty()))
+    {
+        cout << "Seqpacket records are limited to " + to_string(SEQPACKET_MAX_RECORD)
+            + " bytes (and the sweep goes beyond that)" << endl;
+        return false;
+    }
+
+    // cork, Nagle and the not-sent threshold are TCP options
+    bool tcpOnly = sockOpts.nodelay >= 0 || sockOpts.cork != CORK_OFF ||
+                   sockOpts.notsentLowat >= 0 || !matrixName.empty();
+    if (tcpOnly && transportName != "tcp")
+    {
+        cout << "-N, -C, -L and -M need the tcp transport" << endl;
         return false;
     }
     
     return true;
 }
 
+// parseOptions handles the optional flags that follow the 6 positional
+// arguments. Returns false on an unknown flag or a missing value.
+//   -d file   write every per-iteration latency (ns) to file
+//   -P n      run n parallel streams, each on its own connection and thread
+//   -i ms     sample TCP_INFO every ms milliseconds during the transfer
+//   -S name   sweep sizes, splits and write types; write name.csv and name.json
+//   -W n      warm-up runs discarded before each sweep point (default 1)
+//   -R n      measured runs per sweep point (default 5)
+//   -N 0|1    TCP_NODELAY
+//   -C mode   off, tcp (TCP_CORK around each message) or msg_more
+//   -s bytes  SO_SNDBUF on the client
+//   -b bytes  SO_RCVBUF on the server's socket
+//   -L bytes  TCP_NOTSENT_LOWAT on the client
+//   -B usec   SO_BUSY_POLL on both sides
+//   -M name   run every write type under every option combination in the
+//             MATRIX_ lists; write name.csv and name.json
+//   -E bytes  echo mode: the server answers each nbufs * bufsize request
+//             with bytes bytes and every round trip is timed
+//   -D n      echo mode: keep n requests outstanding (default 1, ping-pong)
+//   -T name   transport: tcp (default), unix, seqpacket or shm; the server
+//             must use the same one. Only types 1 to 3 run off TCP.
+bool parseOptions(int numArgs, char *args[]) {
+    for (int i = 7; i < numArgs; i++) {
+        string flag = args[i];
+        if (i + 1 >= numArgs) {
+            cout << "Missing value for " + flag << endl;
+            return false;
+        }
+        if (flag == "-d") {
+            dumpPath = args[++i];
+        } else if (flag == "-i") {
+            infoInterval = atoi(args[++i]);
+        } else if (flag == "-N") {
+            sockOpts.nodelay = atoi(args[++i]);
+        } else if (flag == "-C") {
+            string mode = args[++i];
+            if (mode == "off") sockOpts.cork = CORK_OFF;
+            else if (mode == "tcp") sockOpts.cork = CORK_TCP;
+            else if (mode == "msg_more") sockOpts.cork = CORK_MSG_MORE;
+            else {
+                cout << "Cork mode must be off, tcp or msg_more" << endl;
+                return false;
+            }
+        } else if (flag == "-s") {
+            sockOpts.sndbuf = atoi(args[++i]);
+        } else if (flag == "-b") {
+            sockOpts.rcvbuf = atoi(args[++i]);
+        } else if (flag == "-L") {
+            sockOpts.notsentLowat = atoi(args[++i]);
+        } else if (flag == "-B") {
+            sockOpts.busyPoll = atoi(args[++i]);
+        } else if (flag == "-E") {
+            echoSize = atoi(args[++i]);
+            if (echoSize < 0) {
+                cout << "Echo size cannot be less than zero" << endl;
+                return false;
+            }
+        } else if (flag == "-D") {
+            depth = atoi(args[++i]);
+            if (depth < 1) {
+                cout << "Pipeline depth must be at least 1" << endl;
+                return false;
+            }
+        } else if (flag == "-T") {
+            transportName = args[++i];
+        } else if (flag == "-M") {
+            matrixName = args[++i];
+        } else if (flag == "-S") {
+            sweepName = args[++i];
+        } else if (flag == "-W") {
+            warmups = atoi(args[++i]);
+        } else if (flag == "-R") {
+            runs = atoi(args[++i]);
+            if (runs < 1) {
+                cout << "Runs per sweep point must be at least 1" << endl;
+                return false;
+            }
+        } else if (flag == "-P") {
+            streams = atoi(args[++i]);
+            if (streams < 1) {
+                cout << "Number of streams must be at least 1" << endl;
+                return false;
+            }
+        } else {
+            cout << "Unknown option " + flag << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+
+// The data buffers of the first three types are slices of message, so the
+// same tests work for any nbufs * bufsize (the sweep goes up to 4 MB). They
+// write through s.conn and so run unchanged on every transport.
+
 // multipleWrites invokes the write( ) system call for each data buffer, 
 // thus resulting in calling as many write( )s as the number of data buffers, 
 // (i.e., nbufs). 
-void multipleWrites(int clientSd) {
-    char databuf[nbufs][bufsize]; // where nbufs * bufsize = 1500
+// With -C msg_more every buffer but the last is sent with MSG_MORE, so the
+// kernel holds the partial segment until the message is complete.
+void multipleWrites(Stream &s) {
+    char *databuf = &message[0]; // nbufs buffers of bufsize bytes, back to back
+    bool more = sockOpts.cork == CORK_MSG_MORE;
     for ( int j = 0; j < nbufs; j++ ) {
-        write( clientSd, databuf[j], bufsize ); // clientSd: socket descriptor
+        if (more) {
+            send( s.sd, databuf + j * bufsize, bufsize, j < nbufs - 1 ? MSG_MORE : 0 );
+        } else {
+            s.conn->write( databuf + j * bufsize, bufsize );
+        }
     }
+    s.ioCalls += nbufs;
 }
 
 // writevHelper allocates an array of iovec data structures, each having its *iov_base field
 // point to a different data buffer as well as storing the buffer size in
 // its iov_len field; and thereafter calls writev( ) to send all data buffers at once.
-void writevHelper(int clientSd) {
-    char databuf[nbufs][bufsize]; // where nbufs * bufsize = 1500
+void writevHelper(Stream &s) {
+    char *databuf = &message[0]; // nbufs buffers of bufsize bytes, back to back
     struct iovec vector[nbufs];
     for ( int j = 0; j < nbufs; j++ ) {
-        vector[j].iov_base = databuf[j];
+        vector[j].iov_base = databuf + j * bufsize;
         vector[j].iov_len = bufsize;
     }
-    writev( clientSd, vector, nbufs ); // clientSd: socket descriptor
+    s.conn->writev( vector, nbufs );
+    s.ioCalls++;
 }
 
 // singleWrite allocates an nbufs-sized array of data buffers, and thereafter calls
 // write( ) to send this array, (i.e., all data buffers) at once. 
-void singleWrite(int clientSd) {
-    char databuf[nbufs][bufsize]; // where nbufs * bufsize = 1500
-    write( clientSd, databuf, nbufs * bufsize ); // clientSd: socket descriptor
+void singleWrite(Stream &s) {
+    char *databuf = &message[0]; // nbufs buffers of bufsize bytes, back to back
+    s.conn->write( databuf, nbufs * bufsize );
+    s.ioCalls++;
 }
 
-typedef void(&func)(int); // using func to return void functions
+// reapCompletions drains MSG_ZEROCOPY completion notifications from the
+// socket's error queue and counts how many sends the kernel had to copy
+// anyway. If wait is true it blocks until every send has completed.
+void reapCompletions(Stream &s, bool wait) {
+    while (s.zcCompleted < s.zcSends) {
+        char control[128];
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        // the error queue never blocks; poll( ) reports POLLERR when it fills
+        s.ioCalls++;
+        if (recvmsg(s.sd, &msg, MSG_ERRQUEUE) == -1) {
+            if (errno != EAGAIN || !wait) return;
+            struct pollfd pfd = { s.sd, 0, 0 };
+            poll(&pfd, 1, 100);
+            s.ioCalls++;
+            continue;
+        }
+
+        for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+            struct sock_extended_err *err = (struct sock_extended_err *) CMSG_DATA(cm);
+            if (err->ee_origin != SO_EE_ORIGIN_ZEROCOPY) continue;
+            long n = err->ee_data - err->ee_info + 1; // completed range [ee_info, ee_data]
+            s.zcCompleted += n;
+            if (err->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) s.zcCopied += n;
+        }
+    }
+}
+
+// zeroCopySend sends the whole message with send( MSG_ZEROCOPY ), so the
+// kernel pins the user pages instead of copying them. Completions are reaped
+// as they arrive to keep the error queue short.
+void zeroCopySend(Stream &s) {
+    size_t total = message.size();
+    for (size_t sent = 0; sent < total; ) {
+        ssize_t n = send(s.sd, &message[sent], total - sent, MSG_ZEROCOPY);
+        s.ioCalls++;
+        if (n == -1) {
+            if (errno != ENOBUFS) return;
+            s.zcNoBufs++; // too many pages pinned; wait for completions
+            struct pollfd pfd = { s.sd, 0, 0 };
+            poll(&pfd, 1, 1);
+            s.ioCalls++;
+            reapCompletions(s, false);
+            continue;
+        }
+        s.zcSends++;
+        sent += n;
+    }
+    reapCompletions(s, false);
+}
+
+// spliceWrite maps the message into a pipe with vmsplice( ) and then moves
+// the pipe's pages to the socket with splice( ), avoiding a user copy.
+void spliceWrite(Stream &s) {
+    struct iovec iov;
+    iov.iov_base = &message[0];
+    iov.iov_len = message.size();
+    while (iov.iov_len > 0) {
+        ssize_t n = vmsplice(s.spliceFds[1], &iov, 1, 0);
+        s.ioCalls++;
+        if (n <= 0) return;
+        iov.iov_base = (char *) iov.iov_base + n;
+        iov.iov_len -= n;
+
+        // drain the pipe into the socket
+        for (ssize_t left = n; left > 0; ) {
+            ssize_t m = splice(s.spliceFds[0], nullptr, s.sd, nullptr, left, 0);
+            s.ioCalls++;
+            if (m <= 0) return;
+            left -= m;
+        }
+    }
+}
+
+// sendfileWrite sends the message from a tmpfs file with sendfile( ), so
+// the data goes from the page cache to the socket without a user buffer.
+void sendfileWrite(Stream &s) {
+    off_t offset = 0;
+    off_t total = message.size();
+    while (offset < total) {
+        s.ioCalls++;
+        if (sendfile(s.sd, s.tmpfsFd, &offset, total - offset) <= 0) return;
+    }
+}
+
+// prepareTest sets up whatever the selected write type needs before the
+// timed loop: SO_ZEROCOPY, the splice pipe or the tmpfs file.
+// Returns false if the type is not supported here.
+bool prepareTest(Stream &s) {
+    if (type == ZEROCOPY_SEND) {
+        const int yes = 1;
+        if (setsockopt(s.sd, SOL_SOCKET, SO_ZEROCOPY, &yes, sizeof(yes)) == -1) {
+            cout << "SO_ZEROCOPY is not supported: " << strerror(errno) << endl;
+            return false;
+        }
+    } else if (type == SPLICE_WRITE) {
+        if (pipe(s.spliceFds) == -1) {
+            cout << "Unable to create pipe" << endl;
+            return false;
+        }
+    } else if (type == SENDFILE_WRITE) {
+        char path[64];
+        strcpy(path, TMPFS_TEMPLATE);
+        s.tmpfsFd = mkstemp(path);
+        if (s.tmpfsFd == -1) {
+            cout << "Unable to create " << path << endl;
+            return false;
+        }
+        unlink(path); // removed once the descriptor closes
+        if (write(s.tmpfsFd, &message[0], message.size()) != (ssize_t) message.size()) {
+            cout << "Unable to fill " << path << endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// finishTest waits for outstanding zero-copy completions and releases what
+// prepareTest set up. Calling it again does nothing.
+void finishTest(Stream &s) {
+    if (type == ZEROCOPY_SEND) reapCompletions(s, true);
+    if (s.spliceFds[0] != -1) {
+        close(s.spliceFds[0]);
+        close(s.spliceFds[1]);
+        s.spliceFds[0] = s.spliceFds[1] = -1;
+    }
+    if (s.tmpfsFd != -1) close(s.tmpfsFd);
+    s.tmpfsFd = -1;
+}
+
+// TestGuard finishes the test and stops the TCP_INFO sampler when runStream
+// leaves by any path, before runTest closes the socket under the sampler
+struct TestGuard {
+    Stream &s;
+    explicit TestGuard(Stream &s) : s(s) {}
+    ~TestGuard() {
+        finishTest(s);
+        s.tcpInfo.stop();
+    }
+};
+
+typedef void(&func)(Stream &); // using func to return void functions
 
 // getTest returns the corresponding function to type
 func getTest() {
     if (type == MULTIPLE_WRITES) return multipleWrites; // type 1
     if (type == WRITEV) return writevHelper; // type 2
-    if (type == SINGLE_WRITE) return singleWrite; // type 3
+    if (type == ZEROCOPY_SEND) return zeroCopySend; // type 4
+    if (type == SPLICE_WRITE) return spliceWrite; // type 5
+    if (type == SENDFILE_WRITE) return sendfileWrite; // type 6
+    return singleWrite; // type 3, validateArgs rejects anything else
+}
+
+// elapsedUsec returns b - a in microseconds
+long elapsedUsec(struct timeval a, struct timeval b) {
+    struct timeval diff;
+    timersub(&b, &a, &diff);
+    return diff.tv_sec * 1000000L + diff.tv_usec;
 }
 
 // printStatistices calculates the transmission time and roundtrip time using timeval and
@@ -129,104 +542,462 @@ func getTest() {
 // called read( ). 
 // start is right before client started the write test, lap is when the write test finished,
 // end is when the server responded. numReads is the number of times server called read( ).
-void printStatistics(struct timeval start, struct timeval lap, struct timeval stop, int numReads) {
-    struct timeval trans, round;
-    timersub(&lap, &start, &trans); // trans = lap - start
-    timersub(&stop, &start, &round); // round = stop - start
-
+void printStatistics(Stream &s) {
     // get lapsed time in usec
-    long transmissionTime = trans.tv_sec * 1000000L + trans.tv_usec;
-    long roundTripTime = round.tv_sec * 1000000L + round.tv_usec;
+    long transmissionTime = elapsedUsec(s.start, s.lap);
+    long roundTripTime = elapsedUsec(s.start, s.stop);
     // print times
-    cout << "Test 1: data-transmission time = " + to_string(transmissionTime) + " usec, ";
+    if (streams > 1) cout << "Stream " + to_string(s.id) + ": ";
+    cout << "Test " + to_string(type) + " (" + typeName(type) + "): ";
+    cout << "data-transmission time = " + to_string(transmissionTime) + " usec, ";
     cout << "round-trip time = " + to_string(roundTripTime) + " usec, ";
-    cout << "#reads = " + to_string(numReads) << endl;
+    cout << "#reads = " + to_string(s.numReads);
+    if (echoSize > 0) {
+        double tps = transmissionTime > 0 ? repetition * 1e6 / transmissionTime : 0;
+        cout << ", transactions = " + to_string(repetition);
+        cout << ", transactions/s = " + to_string(tps);
+    }
+    if (streams > 1) {
+        double gbps = roundTripTime > 0 ? message.size() * 8.0 * repetition / roundTripTime / 1e3 : 0;
+        cout << ", throughput = " + to_string(gbps) + " Gbit/s";
+    }
+    cout << endl;
+
+    if (type == ZEROCOPY_SEND) {
+        cout << "zerocopy: sends = " + to_string(s.zcSends);
+        cout << ", completions = " + to_string(s.zcCompleted);
+        cout << ", copied by kernel = " + to_string(s.zcCopied);
+        cout << ", ENOBUFS retries = " + to_string(s.zcNoBufs) << endl;
+    }
 }
 
-// main takes arguments from commandline and attempts to connect to server
-// Once connected, client sends data to server and waits for response.
-// Upon receiving response, it outputs response and then terminates.
-// returns 0 for success, -1 for failure.
-// numArgs is the number of arguments being passed, *args[] is the arguments.
-// args should be in format ./ProgramName serverPort serverName repetition nbufs bufsize type
-int main (int numArgs, char *args[]) {
-    // first argument is program name so there should be 7 arguments in total
-    if (numArgs != 7)
-    {
-        cout << "Incorrect number of arguments provided" << endl;
-        return -1;
+// printAggregate prints the combined throughput of all parallel streams over
+// the wall time from the first start to the last server reply, and Jain's
+// fairness index of the per-stream throughputs:
+// (sum x)^2 / (n * sum x^2), 1.0 when every stream got the same share.
+void printAggregate(vector<Stream *> &all) {
+    double sum = 0, sumSquares = 0;
+    int completed = 0;
+    struct timeval first = {0, 0}, last = {0, 0};
+    LatencyStats latency;
+
+    for (Stream *s : all) {
+        if (!s->ok) continue;
+        double usec = elapsedUsec(s->start, s->stop);
+        double gbps = usec > 0 ? message.size() * 8.0 * repetition / usec / 1e3 : 0;
+        sum += gbps;
+        sumSquares += gbps * gbps;
+        if (completed == 0 || timercmp(&s->start, &first, <)) first = s->start;
+        if (completed == 0 || timercmp(&s->stop, &last, >)) last = s->stop;
+        latency.merge(s->latency);
+        completed++;
     }
 
-    // terminate if invalid arguments
-    if (!validateArgs(args)) {
-        cout << "One or more arguments was invalid" << endl;
-        return -1;
+    if (completed == 0) return;
+    long wall = elapsedUsec(first, last);
+    double aggregate = wall > 0 ? message.size() * 8.0 * repetition * completed / wall / 1e3 : 0;
+    double jain = sumSquares > 0 ? sum * sum / (completed * sumSquares) : 0;
+    cout << "Aggregate: streams = " + to_string(completed) + "/" + to_string(all.size());
+    cout << ", wall time = " + to_string(wall) + " usec";
+    cout << ", throughput = " + to_string(aggregate) + " Gbit/s";
+    cout << ", sum of streams = " + to_string(sum) + " Gbit/s";
+    cout << ", Jain's fairness = " + to_string(jain) << endl;
+    if (echoSize > 0) {
+        long transactions = (long) repetition * completed;
+        cout << "Aggregate: transactions = " + to_string(transactions);
+        cout << ", transactions/s = " + to_string(wall > 0 ? transactions * 1e6 / wall : 0) << endl;
     }
+    latency.print(echoSize > 0 ? "all streams round-trip" : "all streams per-message");
+}
 
-    struct addrinfo hints;
-    struct addrinfo *servInfo; // list of socket addresses from getaddrinfo
-    memset(&hints, 0, sizeof(hints) );
-    hints.ai_family = AF_UNSPEC; // Address Family Internet
-    hints.ai_socktype = SOCK_STREAM; // TCP
-    int status = getaddrinfo(serverName, args[1], &hints, &servInfo );
+// runEcho is the request-response loop of echo mode. Each request is one
+// call of test, answered by an echoSize byte reply. Up to depth requests
+// are outstanding at once; replies come back in order, so the send time of
+// request i sits in slot i % depth until its reply arrives. s.latency gets
+// each round trip, from the start of the request's send to the end of its
+// reply. validateArgs keeps depth * (request + reply) within the socket
+// buffers, since the server does not read while its reply write blocks.
+// Returns false if the server closed the connection.
+bool runEcho(Stream &s, func test, bool cork) {
+    vector<char> reply(echoSize);
+    vector<long long> sent(depth); // send time of each outstanding request
+    int issued = 0;
+
+    for (int done = 0; done < repetition; done++) {
+        // top the pipeline up to depth outstanding requests
+        while (issued < repetition && issued - done < depth) {
+            sent[issued % depth] = monotonicNs();
+            if (cork) setCork(s.sd, true);
+            test(s);
+            if (cork) setCork(s.sd, false);
+            issued++;
+        }
+        if (!readFully(*s.conn, &reply[0], echoSize)) return false;
+        s.ioCalls++; // usually one read( ) per reply
+        s.latency.record(monotonicNs() - sent[done % depth]);
+    }
+    return true;
+}
 
-    // terminate if getaddrinfo failed
-    if (status != 0) {
-        cout << gai_strerror(status) << endl;
-        return -1;
+// runStream connects, sends the test header, waits on the start barrier so
+// all streams begin together, runs the write test repetition times and
+// collects the server's read count. Results are left in s.
+void runStream(Stream &s) {
+    s.conn = transport->connect(serverName, serverPort, sockOpts);
+    bool ready = s.conn != nullptr;
+    if (!ready) cout << "Unable to connect" << endl;
+    else s.sd = s.conn->fd();
+
+    // tell the server what to expect
+    TestHeader header = { TEST_MAGIC, (uint32_t) type, (uint32_t) nbufs,
+                          (uint32_t) bufsize, (uint32_t) repetition,
+                          (uint32_t) sockOpts.rcvbuf, (uint32_t) sockOpts.busyPoll,
+                          (uint32_t) echoSize };
+    if (ready && (!sendHeader(*s.conn, header) || !prepareTest(s))) {
+        cout << "Unable to start test" << endl;
+        ready = false;
     }
 
-    struct addrinfo *p; // current address
-    int clientSd, connection;
+    pthread_barrier_wait(&startBarrier); // every stream reaches here, even failed ones
+    if (!ready) return;
+
+    gettimeofday(&s.start , NULL); // start time
+    TestGuard guard(s);
+    if (s.sd != -1) s.tcpInfo.start(s.sd, infoInterval);
 
-    // iterate over list of socket addresses
-    for (p = servInfo; p != nullptr; p = servInfo->ai_next) {
-        // create socket
-        clientSd = socket( p->ai_family, p->ai_socktype, p->ai_protocol );
+    func test = getTest(); // test is the function that corresponds to type (e.g. singleWrite)
 
-        // try next address
-        if (clientSd == -1) continue;
+    bool cork = sockOpts.cork == CORK_TCP; // cork each message as a unit
+    if (cork) s.ioCalls += 2 * repetition; // two setsockopt( )s per message
+    s.cpu.start();
+
+    if (echoSize > 0) {
+        if (!runEcho(s, test, cork)) {
+            cout << "Server closed the connection during echo" << endl;
+            return;
+        }
+    } else {
+        // call test until repetitions satisfied
+        for (int i = 0; i < repetition; i++) {
+            long long begin = monotonicNs();
+            if (cork) setCork(s.sd, true);
+            test(s);
+            if (cork) setCork(s.sd, false);
+            s.latency.record(monotonicNs() - begin);
+        }
+    }
 
-        // open connection on socket file descriptor (clientSd)
-        connection = connect( clientSd, p->ai_addr, p->ai_addrlen);
+    finishTest(s); // zero-copy sends are done once completions are in
+    gettimeofday(&s.lap, nullptr);
+    int temp;
 
-        // try next address if connect failed
-        if (connection == -1) continue;
-        
-        break; // stop if socket and connect succeeded
+    // get server's response
+    if (!readFully(*s.conn, &temp, sizeof(temp))) {
+        cout << "Unable to read." << endl;
+        return;
     }
 
-    // all addresses failed, terminate
-    if (!p) {
-        cout << "Unable to connect" << endl;
-        return -1;
+    s.numReads = ntohl(temp);
+    gettimeofday(&s.stop, nullptr);
+    s.cpu.stop();
+    s.ioCalls++; // the read count
+    s.tcpInfo.stop();
+    s.ok = true;
+}
+
+// streamThread is the pthread entry point for one parallel stream
+void *streamThread(void *data) {
+    runStream(*(Stream *) data);
+    return nullptr;
+}
+
+// runTest runs the current type, nbufs, bufsize and repetition over
+// streams parallel connections and returns them, results inside.
+// Stream 0 runs on the calling thread; the others get their own.
+vector<Stream *> runTest() {
+    message.assign(nbufs * bufsize, 'x');
+    pthread_barrier_init(&startBarrier, nullptr, streams);
+
+    vector<Stream *> all;
+    vector<pthread_t> threads(streams);
+    for (int i = 0; i < streams; i++) all.push_back(new Stream(i));
+
+    int started = 1;
+    for (; started < streams; started++) {
+        if (pthread_create(&threads[started], nullptr, streamThread, all[started]) != 0) {
+            cout << "Unable to create thread." << endl;
+            exit(-1); // the barrier would never open
+        }
     }
+    runStream(*all[0]);
+    for (int i = 1; i < streams; i++) pthread_join(threads[i], nullptr);
 
-    freeaddrinfo(servInfo);
-    struct timeval start , lap , stop;
-    gettimeofday(&start , NULL); // start time
+    pthread_barrier_destroy(&startBarrier);
+    for (Stream *s : all) {
+        delete s->conn; // closes the connection
+        s->conn = nullptr;
+    }
+    return all;
+}
 
-    func test = getTest(); // test is the function that corresponds to type (e.g. singleWrite)
+// aggregateGbps returns the combined throughput of a finished run: all
+// bytes over the wall time from the first start to the last server reply.
+// Returns -1 if any stream failed.
+double aggregateGbps(vector<Stream *> &all) {
+    struct timeval first = all[0]->start, last = all[0]->stop;
+    for (Stream *s : all) {
+        if (!s->ok) return -1;
+        if (timercmp(&s->start, &first, <)) first = s->start;
+        if (timercmp(&s->stop, &last, >)) last = s->stop;
+    }
+    long wall = elapsedUsec(first, last);
+    return wall > 0 ? message.size() * 8.0 * repetition * all.size() / wall / 1e3 : 0;
+}
 
-    // call test until repetitions satisfied
-    for (int i = 0; i < repetition; i++) {
-        test(clientSd);
+// studentT95 returns the two-sided 95% Student t value for n samples
+double studentT95(int n) {
+    static const double t[] = { 0, 12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365,
+        2.306, 2.262, 2.228, 2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101,
+        2.093, 2.086, 2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045 };
+    int dof = n - 1;
+    if (dof < 1) return 0;
+    return dof < 30 ? t[dof] : 1.96;
+}
+
+// SweepPoint is one measured configuration of the sweep
+struct SweepPoint {
+    SocketOptions opts; // options in effect
+    int type, size, nbufs, bufsize, repetition, runs;
+    double meanGbps, stddevGbps, ci95Gbps; // throughput over the runs
+    double meanMessageUsec, p99MessageUsec; // time per message (all of its writes) over all runs
+};
+
+// measurePoint runs warmups discarded runs and then runs measured ones for
+// the current globals, and summarizes them
+SweepPoint measurePoint() {
+    SweepPoint point = { sockOpts, type, nbufs * bufsize, nbufs, bufsize, repetition, 0, 0, 0, 0, 0, 0 };
+    vector<double> samples;
+    LatencyStats latency;
+
+    for (int r = 0; r < warmups + runs; r++) {
+        vector<Stream *> all = runTest();
+        double gbps = aggregateGbps(all);
+        if (r >= warmups && gbps >= 0) {
+            samples.push_back(gbps);
+            for (Stream *s : all) latency.merge(s->latency);
+        }
+        for (Stream *s : all) delete s;
     }
 
-    gettimeofday(&lap, nullptr);
-    int temp, numReads;
+    point.runs = samples.size();
+    if (samples.empty()) return point;
+    double sum = 0, sumSquares = 0;
+    for (double x : samples) sum += x;
+    point.meanGbps = sum / samples.size();
+    for (double x : samples) sumSquares += (x - point.meanGbps) * (x - point.meanGbps);
+    if (samples.size() > 1) {
+        point.stddevGbps = sqrt(sumSquares / (samples.size() - 1));
+        point.ci95Gbps = studentT95(samples.size()) * point.stddevGbps / sqrt(samples.size());
+    }
+    point.meanMessageUsec = latency.histogram().mean() / 1e3;
+    point.p99MessageUsec = latency.histogram().percentile(99) / 1e3;
+    return point;
+}
 
-    // get server's response
-    int readResult = read(clientSd, &temp, sizeof(temp));
+// writeSweep writes sweep or matrix results to <name>.csv and <name>.json
+void writeSweep(const string &name, const vector<SweepPoint> &points) {
+    ofstream csv(name + ".csv"), json(name + ".json");
+    if (!csv || !json) {
+        cout << "Unable to write " + name + ".csv/.json" << endl;
+        return;
+    }
 
-    if (readResult == -1) {
-        cout << "Unable to read." << endl;
-        return -1;
+    csv << "type,name,size,nbufs,bufsize,repetition,streams,runs,"
+           "nodelay,cork,sndbuf,rcvbuf,notsent_lowat,busy_poll,"
+           "mean_gbps,stddev_gbps,ci95_gbps,mean_message_usec,p99_message_usec\n";
+    json << "{\n  \"server\": \"" << serverName << "\", \"streams\": " << streams
+         << ", \"warmups\": " << warmups << ",\n  \"points\": [\n";
+    for (size_t i = 0; i < points.size(); i++) {
+        const SweepPoint &p = points[i];
+        const SocketOptions &o = p.opts;
+        char line[640];
+        snprintf(line, sizeof(line), "%d,%s,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%.4f,%.4f,%.4f,%.3f,%.3f\n",
+                 p.type, typeName(p.type), p.size, p.nbufs, p.bufsize, p.repetition,
+                 streams, p.runs, o.nodelay, o.cork, o.sndbuf, o.rcvbuf, o.notsentLowat,
+                 o.busyPoll, p.meanGbps, p.stddevGbps, p.ci95Gbps,
+                 p.meanMessageUsec, p.p99MessageUsec);
+        csv << line;
+        snprintf(line, sizeof(line),
+                 "    {\"type\": %d, \"name\": \"%s\", \"size\": %d, \"nbufs\": %d, "
+                 "\"bufsize\": %d, \"repetition\": %d, \"runs\": %d, \"nodelay\": %d, "
+                 "\"cork\": %d, \"sndbuf\": %d, \"rcvbuf\": %d, \"notsent_lowat\": %d, "
+                 "\"busy_poll\": %d, \"mean_gbps\": %.4f, "
+                 "\"stddev_gbps\": %.4f, \"ci95_gbps\": %.4f, \"mean_message_usec\": %.3f, "
+                 "\"p99_message_usec\": %.3f}%s\n",
+                 p.type, typeName(p.type), p.size, p.nbufs, p.bufsize, p.repetition,
+                 p.runs, o.nodelay, o.cork, o.sndbuf, o.rcvbuf, o.notsentLowat, o.busyPoll,
+                 p.meanGbps, p.stddevGbps, p.ci95Gbps, p.meanMessageUsec,
+                 p.p99MessageUsec, i + 1 < points.size() ? "," : "");
+        json << line;
+    }
+    json << "  ]\n}\n";
+    cout << "Wrote " + name + ".csv and " + name + ".json" << endl;
+}
+
+// sweep measures every write type for message sizes from 64 B to 4 MB.
+// The split types (1-3) are also run for every nbufs in SWEEP_SPLITS that
+// fits the size. Repetitions per run are capped so one run moves at most
+// SWEEP_BYTES. Returns 0 if every point completed.
+int sweep() {
+    vector<SweepPoint> points;
+    int maxRepetition = repetition;
+
+    for (int size = SWEEP_MIN_SIZE; size <= SWEEP_MAX_SIZE; size *= 2) {
+        repetition = (int) min((long) maxRepetition, max(1L, SWEEP_BYTES / size));
+        for (type = 1; type <= maxType(); type++) {
+            for (int split : SWEEP_SPLITS) {
+                bool splitType = type <= SINGLE_WRITE;
+                if (split > size || (!splitType && split != 1)) continue;
+                if (type == WRITEV && split > IOV_MAX) continue;
+                nbufs = split;
+                bufsize = size / split;
+
+                SweepPoint p = measurePoint();
+                points.push_back(p);
+                char line[160];
+                snprintf(line, sizeof(line), "%-16s size = %8d, nbufs = %4d: %9.4f Gbit/s +/- %.4f (%d runs)",
+                         typeName(p.type), p.size, p.nbufs, p.meanGbps, p.ci95Gbps, p.runs);
+                cout << line << endl;
+            }
+        }
     }
 
-    numReads = ntohl(temp);
-    gettimeofday(&stop, nullptr);
-    printStatistics(start, lap, stop, numReads);
-    close(clientSd);
+    writeSweep(sweepName, points);
+    for (const SweepPoint &p : points) {
+        if (p.runs < runs) return -1;
+    }
     return 0;
-}
\ No newline at end of file
+}
+
+// matrix measures every write type, at the nbufs and bufsize given on the
+// command line, under every combination of the MATRIX_ option values. Each
+// result is compared with the first combination (kernel defaults) for the
+// same type, and the best throughput and best p99 combination per type are
+// listed at the end. Returns 0 if every point completed.
+int matrix() {
+    vector<SweepPoint> points;
+    vector<SweepPoint> baseline(NUM_TYPES + 1);
+
+    for (int nodelay : MATRIX_NODELAY)
+    for (int cork : MATRIX_CORK)
+    for (int sndbuf : MATRIX_SNDBUF)
+    for (int rcvbuf : MATRIX_RCVBUF)
+    for (int lowat : MATRIX_NOTSENT_LOWAT)
+    for (int busyPoll : MATRIX_BUSY_POLL) {
+        sockOpts.nodelay = nodelay;
+        sockOpts.cork = cork;
+        sockOpts.sndbuf = sndbuf;
+        sockOpts.rcvbuf = rcvbuf;
+        sockOpts.notsentLowat = lowat;
+        sockOpts.busyPoll = busyPoll;
+        cout << describe(sockOpts) << endl;
+
+        for (type = 1; type <= NUM_TYPES; type++) {
+            SweepPoint p = measurePoint();
+            if (points.size() < (size_t) NUM_TYPES) baseline[type] = p; // first combination
+            points.push_back(p);
+            double ratio = baseline[type].meanGbps > 0 ? p.meanGbps / baseline[type].meanGbps : 0;
+            char line[200];
+            snprintf(line, sizeof(line), "  %-16s %9.4f Gbit/s +/- %.4f (x%.2f vs default), "
+                     "message mean = %.3f usec, p99 = %.3f usec",
+                     typeName(type), p.meanGbps, p.ci95Gbps, ratio, p.meanMessageUsec, p.p99MessageUsec);
+            cout << line << endl;
+        }
+    }
+
+    cout << "Best per write type:" << endl;
+    for (int t = 1; t <= NUM_TYPES; t++) {
+        const SweepPoint *fastest = nullptr, *lowest = nullptr;
+        for (const SweepPoint &p : points) {
+            if (p.type != t || p.runs == 0) continue;
+            if (!fastest || p.meanGbps > fastest->meanGbps) fastest = &p;
+            if (!lowest || p.p99MessageUsec < lowest->p99MessageUsec) lowest = &p;
+        }
+        if (!fastest) continue;
+        cout << "  " << typeName(t) << ": throughput " << fastest->meanGbps << " Gbit/s with "
+             << describe(fastest->opts) << endl;
+        cout << "  " << typeName(t) << ": p99 per message " << lowest->p99MessageUsec << " usec with "
+             << describe(lowest->opts) << endl;
+    }
+
+    writeSweep(matrixName, points);
+    for (const SweepPoint &p : points) {
+        if (p.runs < runs) return -1;
+    }
+    return 0;
+}
+
+// main takes arguments from commandline and attempts to connect to server
+// Once connected, client sends data to server and waits for response.
+// Upon receiving response, it outputs response and then terminates.
+// With -P n it does the same over n connections at once, one thread each,
+// and also prints the aggregate throughput and fairness. With -S it runs
+// the parameter sweep and with -M the socket option matrix instead of a
+// single test. With -E the server answers every message and the client
+// reports round trips and transactions/s instead of write times.
+// returns 0 for success, -1 for failure.
+// numArgs is the number of arguments being passed, *args[] is the arguments.
+// args should be in format ./ProgramName serverPort serverName repetition nbufs bufsize type [options]
+// type: 1 multiple writes, 2 writev, 3 single write, 4 send(MSG_ZEROCOPY),
+//       5 vmsplice + splice, 6 sendfile from tmpfs
+// In sweep mode nbufs, bufsize and type are ignored and repetition is the
+// most repetitions any one run performs.
+int main (int numArgs, char *args[]) {
+    // first argument is program name so there should be at least 7 arguments
+    if (numArgs < 7)
+    {
+        cout << "Incorrect number of arguments provided" << endl;
+        return -1;
+    }
+
+    // terminate if invalid arguments
+    if (!parseOptions(numArgs, args) || !validateArgs(args)) {
+        cout << "One or more arguments was invalid" << endl;
+        return -1;
+    }
+
+    transport = makeTransport(transportName);
+    if (!transport) {
+        cout << "Unknown transport " + transportName << endl;
+        return -1;
+    }
+
+    if (!sweepName.empty()) return sweep();
+    if (!matrixName.empty()) return matrix();
+
+    vector<Stream *> all = runTest();
+
+    bool ok = true;
+    for (Stream *s : all) {
+        if (s->ok) {
+            printStatistics(*s);
+            s->latency.print(echoSize > 0 ? "round-trip" : "per-message");
+            string label = streams > 1 ? "stream " + to_string(s->id) : "client";
+            s->tcpInfo.print(label);
+            s->cpu.print(label, (long long) message.size() * repetition, repetition, s->ioCalls);
+        } else {
+            ok = false;
+        }
+    }
+
+    if (streams > 1) printAggregate(all);
+    if (!dumpPath.empty()) {
+        LatencyStats samples(true);
+        for (Stream *s : all) samples.merge(s->latency);
+        samples.dumpSamples(dumpPath);
+    }
+
+    for (Stream *s : all) delete s;
+    delete transport;
+    return ok ? 0 : -1;
+}
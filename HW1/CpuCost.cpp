@@ -0,0 +1,144 @@
+/**
+ * Author: Tanvir Tatla
+ * Description: perf_event_open and getrusage accounting, see CpuCost.h
+**/
+#include "CpuCost.h"
+#include <iostream> // cout
+#include <fstream> // ifstream
+#include <cstring> // memset
+#include <cstdio> // snprintf
+#include <unistd.h> // syscall, read, close
+#include <sys/ioctl.h> // ioctl
+#include <sys/syscall.h> // SYS_perf_event_open
+#include <linux/perf_event.h> // perf_event_attr
+
+using namespace std;
+
+// syscallTracepoint returns the id of the raw_syscalls:sys_enter tracepoint,
+// -1 if tracefs is not readable
+static long long syscallTracepoint() {
+    const char *paths[] = { "/sys/kernel/tracing/events/raw_syscalls/sys_enter/id",
+                            "/sys/kernel/debug/tracing/events/raw_syscalls/sys_enter/id" };
+    for (const char *path : paths) {
+        ifstream in(path);
+        long long id;
+        if (in >> id) return id;
+    }
+    return -1;
+}
+
+// openCounter opens one disabled counter on the calling thread, -1 on failure
+static int openCounter(unsigned type, unsigned long long config, bool userOnly) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = userOnly;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0); // this thread, any cpu
+}
+
+CpuCost::CpuCost() : userOnly(false), started(false) {
+    for (int i = 0; i < NUM_COUNTERS; i++) {
+        fds[i] = -1;
+        values[i] = 0;
+    }
+    memset(&before, 0, sizeof(before));
+    memset(&after, 0, sizeof(after));
+}
+
+CpuCost::~CpuCost() {
+    for (int fd : fds) {
+        if (fd != -1) close(fd);
+    }
+}
+
+void CpuCost::start() {
+    for (int &fd : fds) { // a second start( ) measures afresh
+        if (fd != -1) close(fd);
+        fd = -1;
+    }
+
+    // count kernel work too if allowed: most of a transfer is spent in
+    // system calls. Otherwise fall back to user space only, where context
+    // switches are invisible and come from getrusage instead.
+    fds[CONTEXT_SWITCHES] = openCounter(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, false);
+    userOnly = fds[CONTEXT_SWITCHES] == -1;
+    fds[CYCLES] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, userOnly);
+    fds[INSTRUCTIONS] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, userOnly);
+    fds[CACHE_MISSES] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, userOnly);
+    long long tracepoint = syscallTracepoint();
+    if (tracepoint != -1) fds[SYSCALLS] = openCounter(PERF_TYPE_TRACEPOINT, tracepoint, false);
+
+    getrusage(RUSAGE_THREAD, &before);
+    for (int fd : fds) {
+        if (fd == -1) continue;
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+    started = true;
+}
+
+void CpuCost::stop() {
+    if (!started) return;
+    for (int fd : fds) {
+        if (fd != -1) ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    }
+    getrusage(RUSAGE_THREAD, &after);
+
+    for (int i = 0; i < NUM_COUNTERS; i++) {
+        if (fds[i] == -1) continue;
+        // value, time enabled, time running: scale up if the PMU was shared
+        unsigned long long data[3];
+        if (read(fds[i], data, sizeof(data)) != sizeof(data) || data[2] == 0) {
+            close(fds[i]);
+            fds[i] = -1; // never ran, report as unavailable
+            continue;
+        }
+        values[i] = (long long) ((double) data[0] * data[1] / data[2]);
+    }
+    started = false;
+}
+
+static long long usecOf(const struct timeval &tv) {
+    return tv.tv_sec * 1000000LL + tv.tv_usec;
+}
+
+void CpuCost::print(const string &label, long long bytes, long messages, long ioCalls) const {
+    long long user = usecOf(after.ru_utime) - usecOf(before.ru_utime);
+    long long sys = usecOf(after.ru_stime) - usecOf(before.ru_stime);
+    char line[200];
+
+    cout << label + " cpu: ";
+    if (fds[CYCLES] != -1) {
+        double cyclesPerByte = bytes > 0 ? (double) values[CYCLES] / bytes : 0;
+        snprintf(line, sizeof(line), "cycles = %lld, cycles/byte = %.3f", values[CYCLES], cyclesPerByte);
+        cout << line;
+        if (fds[INSTRUCTIONS] != -1 && values[CYCLES] > 0) {
+            snprintf(line, sizeof(line), ", instructions = %lld, IPC = %.2f", values[INSTRUCTIONS],
+                     (double) values[INSTRUCTIONS] / values[CYCLES]);
+            cout << line;
+        }
+        if (fds[CACHE_MISSES] != -1) cout << ", cache misses = " << values[CACHE_MISSES];
+        if (userOnly) cout << " (user space only)";
+    } else {
+        cout << "cycles = n/a (no hardware counters or perf_event_open not allowed)";
+    }
+
+    // the software counter needs no PMU; getrusage is the last resort
+    long long switches = fds[CONTEXT_SWITCHES] != -1 ? values[CONTEXT_SWITCHES]
+        : (after.ru_nvcsw - before.ru_nvcsw) + (after.ru_nivcsw - before.ru_nivcsw);
+    cout << ", context switches = " << switches;
+    snprintf(line, sizeof(line), ", user = %lld usec, sys = %lld usec, cpu time/byte = %.3f ns",
+             user, sys, bytes > 0 ? (user + sys) * 1000.0 / bytes : 0);
+    cout << line << endl;
+
+    long long calls = fds[SYSCALLS] != -1 ? values[SYSCALLS] : ioCalls;
+    snprintf(line, sizeof(line), "%s syscalls: %s = %lld, per message = %.2f", label.c_str(),
+             fds[SYSCALLS] != -1 ? "all (perf)" : "I/O calls", calls,
+             messages > 0 ? (double) calls / messages : 0);
+    cout << line << endl;
+}
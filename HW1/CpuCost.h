@@ -0,0 +1,46 @@
+/**
+ * Author: Tanvir Tatla
+ * Description: CPU cost of a transfer for the HW1 programs. perf_event_open
+ *              counts cycles, instructions, cache misses, context switches
+ *              and system calls of the calling thread, and getrusage gives
+ *              its user and system time. Counters the kernel or the machine
+ *              does not allow (perf_event_paranoid, containers, VMs without
+ *              a PMU) are skipped; without a system call counter the caller's
+ *              own count of I/O calls is reported instead.
+**/
+#ifndef _CPUCOST_H_
+#define _CPUCOST_H_
+
+#include <string> // string
+#include <sys/resource.h> // rusage
+
+class CpuCost {
+ public:
+    CpuCost();
+    ~CpuCost();
+    // open and enable the counters for the calling thread; start and stop
+    // must run on the same thread
+    void start();
+    void stop();
+    // print cycles/byte, instructions, cache misses, context switches,
+    // user/sys time (also per byte, for machines without counters) and
+    // system calls per message. ioCalls is the caller's
+    // count of its own I/O calls, used if system calls could not be counted.
+    void print(const std::string &label, long long bytes, long messages, long ioCalls) const;
+
+    // counters
+    static const int CYCLES = 0;
+    static const int INSTRUCTIONS = 1;
+    static const int CACHE_MISSES = 2;
+    static const int CONTEXT_SWITCHES = 3;
+    static const int SYSCALLS = 4;
+    static const int NUM_COUNTERS = 5;
+ private:
+    int fds[NUM_COUNTERS]; // -1 if the counter could not be opened
+    long long values[NUM_COUNTERS]; // scaled for multiplexing
+    bool userOnly; // kernel events excluded (perf_event_paranoid >= 2)
+    bool started;
+    struct rusage before, after; // RUSAGE_THREAD
+};
+
+#endif
@@ -0,0 +1,379 @@
+/**
+ * Author: Tanvir Tatla
+ * Description: Event-driven HW1 server mode, see EpollServer.h
+**/
+#include "EpollServer.h"
+#include "Protocol.h" // TestHeader, decodeHeader, typeName
+#include "Latency.h" // monotonicNs
+#include "SocketOptions.h" // applyReceiverOptions
+#include <iostream> // cout
+#include <vector> // vector
+#include <algorithm> // sort, min
+#include <atomic> // atomic
+#include <cerrno> // errno
+#include <cstring> // strerror
+#include <cstdio> // snprintf
+#include <fcntl.h> // fcntl
+#include <unistd.h> // read, write, close, sleep
+#include <netinet/in.h> // IPPROTO_TCP
+#include <netinet/tcp.h> // TCP_NODELAY
+#include <sys/epoll.h> // epoll_create1, epoll_ctl, epoll_wait
+#include <sys/resource.h> // setrlimit
+#include <pthread.h> // pthread_create, pthread_mutex_t
+
+#ifndef EPOLLEXCLUSIVE
+#define EPOLLEXCLUSIVE (1u << 28)
+#endif
+
+using namespace std;
+
+const int MAX_EVENTS = 256; // events taken per epoll_wait( )
+const int READS_PER_EVENT = 16; // then let the worker's other connections run
+const int ACCEPTS_PER_EVENT = 32; // leave the rest of a burst to other workers
+const int SCRATCH_SIZE = 256 * 1024; // per-worker receive buffer, data is discarded
+const int REPLY_CHUNK = 64 * 1024; // echo replies are written from this
+const int EPOLL_TIMEOUT_MS = 100; // recheck stopping this often
+const int SLOWEST = 10; // connections listed by a report
+
+// ConnStats is what the server keeps about one connection
+struct ConnStats {
+    int id; // order of acceptance
+    int type; // client's write type, 0 until the header is in
+    long long bytes, expected; // data received, data announced by the header
+    long reads; // read( ) calls that returned data
+    long long startNs, lastNs; // header complete, latest data
+    bool done; // all data received and answered
+    bool failed; // bad header or the client closed early
+};
+
+// EpollConnection is the state of one connection inside its worker
+struct EpollConnection {
+    Connection *conn;
+    int sd;
+    size_t slot; // index in the worker's active list
+    ConnStats stats;
+    TestHeader header;
+    size_t headerBytes; // header bytes read so far
+    long long owed; // echo reply bytes not yet written
+    long messages; // complete messages received
+    uint32_t count; // read count in network order, sent last
+    size_t countSent; // bytes of count written
+    bool wantOut; // registered for EPOLLOUT
+};
+
+// Worker is one thread with its own epoll set. lock is held while the
+// worker handles a batch of events and while a report reads its lists.
+struct Worker {
+    pthread_t thread;
+    int epfd;
+    pthread_mutex_t lock;
+    vector<EpollConnection *> active;
+    vector<ConnStats> finished;
+};
+
+static Transport *listener; // shared by all workers
+static volatile sig_atomic_t *stopFlag;
+static atomic<int> nextId(0);
+static const vector<char> replyData(REPLY_CHUNK, 'y');
+
+// setInterest registers c for EPOLLOUT only while it has output pending
+static void setInterest(Worker &w, EpollConnection &c, bool out) {
+    if (c.wantOut == out) return;
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLRDHUP | (out ? EPOLLOUT : 0);
+    ev.data.ptr = &c;
+    epoll_ctl(w.epfd, EPOLL_CTL_MOD, c.sd, &ev);
+    c.wantOut = out;
+}
+
+// acceptSome takes pending connections off the shared listener
+static void acceptSome(Worker &w) {
+    for (int i = 0; i < ACCEPTS_PER_EVENT; i++) {
+        Connection *conn = listener->accept();
+        if (!conn) return; // nothing pending (or out of descriptors)
+
+        EpollConnection *c = new EpollConnection();
+        c->conn = conn;
+        c->sd = conn->fd();
+        fcntl(c->sd, F_SETFL, fcntl(c->sd, F_GETFL) | O_NONBLOCK);
+        c->stats.id = nextId++;
+        c->stats.startNs = c->stats.lastNs = monotonicNs();
+        c->slot = w.active.size();
+        w.active.push_back(c);
+
+        struct epoll_event ev;
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        ev.data.ptr = c;
+        epoll_ctl(w.epfd, EPOLL_CTL_ADD, c->sd, &ev);
+    }
+}
+
+// retire moves c's statistics to the finished list and closes it
+static void retire(Worker &w, EpollConnection *c) {
+    epoll_ctl(w.epfd, EPOLL_CTL_DEL, c->sd, nullptr);
+    w.finished.push_back(c->stats);
+    w.active[c->slot] = w.active.back();
+    w.active[c->slot]->slot = c->slot;
+    w.active.pop_back();
+    delete c->conn; // close connection
+    delete c;
+}
+
+// startTest applies the header: socket options, Nagle off for echo replies
+static void startTest(EpollConnection &c) {
+    const TestHeader &h = c.header;
+    c.stats.type = h.type;
+    c.stats.expected = (long long) h.nbufs * h.bufsize * h.repetition;
+    c.stats.startNs = c.stats.lastNs = monotonicNs();
+    applyReceiverOptions(c.sd, (int) h.rcvbuf, (int) h.busyPoll);
+    if (h.echoSize > 0) {
+        int yes = 1;
+        setsockopt(c.sd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+    }
+}
+
+// receive reads what is queued, up to READS_PER_EVENT calls. Returns false
+// if the client sent a bad header or closed before sending everything.
+static bool receive(EpollConnection &c, vector<char> &scratch) {
+    for (int r = 0; r < READS_PER_EVENT; r++) {
+        ssize_t n;
+        if (c.headerBytes < sizeof(TestHeader)) {
+            n = read(c.sd, (char *) &c.header + c.headerBytes, sizeof(TestHeader) - c.headerBytes);
+            if (n > 0) {
+                c.headerBytes += n;
+                if (c.headerBytes < sizeof(TestHeader)) continue;
+                if (!decodeHeader(c.header)) return false;
+                startTest(c);
+                continue;
+            }
+        } else {
+            long long left = c.stats.expected - c.stats.bytes;
+            if (left == 0) return true; // everything is in
+            n = read(c.sd, &scratch[0], (size_t) min(left, (long long) scratch.size()));
+            if (n > 0) {
+                c.stats.reads++;
+                c.stats.bytes += n;
+                c.stats.lastNs = monotonicNs();
+                long long msgSize = (long long) c.header.nbufs * c.header.bufsize;
+                if (c.header.echoSize > 0 && msgSize > 0) {
+                    long messages = c.stats.bytes / msgSize;
+                    c.owed += (long long) (messages - c.messages) * c.header.echoSize;
+                    c.messages = messages;
+                }
+                continue;
+            }
+        }
+        if (n == 0) return false; // closed early
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) return true;
+        return false;
+    }
+    return true;
+}
+
+// respond writes owed echo replies and, once all data is in, the read
+// count. Returns true once the count is out; sets EPOLLOUT interest when
+// the socket buffer is full. ok is cleared on a write error.
+static bool respond(Worker &w, EpollConnection &c, bool &ok) {
+    while (c.owed > 0) {
+        ssize_t n = write(c.sd, &replyData[0], (size_t) min(c.owed, (long long) replyData.size()));
+        if (n < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) ok = false;
+            else setInterest(w, c, true);
+            return false;
+        }
+        c.owed -= n;
+    }
+
+    if (c.headerBytes < sizeof(TestHeader) || c.stats.bytes < c.stats.expected) {
+        setInterest(w, c, false);
+        return false;
+    }
+
+    if (c.countSent == 0) c.count = htonl((uint32_t) c.stats.reads);
+    while (c.countSent < sizeof(c.count)) {
+        ssize_t n = write(c.sd, (char *) &c.count + c.countSent, sizeof(c.count) - c.countSent);
+        if (n < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) ok = false;
+            else setInterest(w, c, true);
+            return false;
+        }
+        c.countSent += n;
+    }
+    c.stats.done = true;
+    return true;
+}
+
+// serve handles one event; returns false when the connection is finished
+static bool serve(Worker &w, EpollConnection &c, uint32_t events, vector<char> &scratch) {
+    bool ok = !(events & EPOLLERR);
+    if (ok && (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP))) ok = receive(c, scratch);
+    if (ok && respond(w, c, ok)) return false; // done
+    if (!ok) c.stats.failed = true;
+    return ok;
+}
+
+static void *workerLoop(void *data) {
+    Worker &w = *(Worker *) data;
+    vector<char> scratch(SCRATCH_SIZE);
+    struct epoll_event events[MAX_EVENTS];
+
+    while (!*stopFlag) {
+        int n = epoll_wait(w.epfd, events, MAX_EVENTS, EPOLL_TIMEOUT_MS);
+        if (n <= 0) continue;
+        pthread_mutex_lock(&w.lock);
+        for (int i = 0; i < n; i++) {
+            EpollConnection *c = (EpollConnection *) events[i].data.ptr;
+            if (!c) {
+                acceptSome(w); // the listener
+            } else if (!serve(w, *c, events[i].events, scratch)) {
+                retire(w, c);
+            }
+        }
+        pthread_mutex_unlock(&w.lock);
+    }
+    return nullptr;
+}
+
+// gbpsOf returns a connection's throughput, up to now if still receiving
+static double gbpsOf(const ConnStats &s, long long now) {
+    long long ns = (s.done || s.failed ? s.lastNs : now) - s.startNs;
+    return ns > 0 ? s.bytes * 8.0 / ns : 0;
+}
+
+// printReport prints the aggregate over every connection so far and the
+// SLOWEST connections by throughput
+static void printReport(vector<Worker> &workers, const string &title) {
+    vector<ConnStats> all;
+    int active = 0;
+    for (Worker &w : workers) {
+        pthread_mutex_lock(&w.lock);
+        for (EpollConnection *c : w.active) all.push_back(c->stats);
+        active += w.active.size();
+        all.insert(all.end(), w.finished.begin(), w.finished.end());
+        pthread_mutex_unlock(&w.lock);
+    }
+
+    long long now = monotonicNs();
+    long long bytes = 0, first = 0, last = 0;
+    int done = 0, failed = 0;
+    double sum = 0, sumSquares = 0;
+    vector<pair<double, const ConnStats *> > rates; // connections past their header
+    for (const ConnStats &s : all) {
+        bytes += s.bytes;
+        if (s.done) done++;
+        if (s.failed) failed++;
+        if (s.type == 0) continue;
+        long long end = s.done || s.failed ? s.lastNs : now;
+        if (rates.empty() || s.startNs < first) first = s.startNs;
+        if (rates.empty() || end > last) last = end;
+        double gbps = gbpsOf(s, now);
+        sum += gbps;
+        sumSquares += gbps * gbps;
+        rates.push_back(make_pair(gbps, &s));
+    }
+    sort(rates.begin(), rates.end(),
+         [](const pair<double, const ConnStats *> &a, const pair<double, const ConnStats *> &b) {
+             return a.first < b.first;
+         });
+
+    cout << title + ": connections = " + to_string(all.size());
+    cout << ", active = " + to_string(active) + ", done = " + to_string(done);
+    cout << ", failed = " + to_string(failed) + ", bytes = " + to_string(bytes);
+    if (!rates.empty()) {
+        double wall = (last - first) / 1e3; // usec
+        double aggregate = wall > 0 ? bytes * 8.0 / wall / 1e3 : 0;
+        double jain = sumSquares > 0 ? sum * sum / (rates.size() * sumSquares) : 0;
+        cout << ", wall time = " + to_string((long long) wall) + " usec";
+        cout << ", throughput = " + to_string(aggregate) + " Gbit/s";
+        cout << ", Jain's fairness = " + to_string(jain) << endl;
+        char line[200];
+        snprintf(line, sizeof(line), "per-connection Gbit/s: min = %.4f, p50 = %.4f, mean = %.4f, max = %.4f",
+                 rates.front().first, rates[rates.size() / 2].first, sum / rates.size(), rates.back().first);
+        cout << line << endl;
+    } else {
+        cout << endl;
+    }
+
+    int listed = min((int) rates.size(), SLOWEST);
+    if (listed > 0) cout << "slowest " + to_string(listed) + " connections:" << endl;
+    for (int i = 0; i < listed; i++) {
+        const ConnStats &s = *rates[i].second;
+        const char *state = s.done ? "done" : s.failed ? "failed" : "active";
+        long long usec = ((s.done || s.failed ? s.lastNs : now) - s.startNs) / 1000;
+        char line[240];
+        snprintf(line, sizeof(line), "  #%-6d %-16s %-6s bytes = %lld/%lld, %.4f Gbit/s, "
+                 "time = %lld usec, #reads = %ld, bytes/read = %lld",
+                 s.id, typeName(s.type), state, s.bytes, s.expected, rates[i].first, usec,
+                 s.reads, s.reads > 0 ? s.bytes / s.reads : 0);
+        cout << line << endl;
+    }
+}
+
+// raiseFileLimit lets the server hold as many connections as the hard limit allows
+static void raiseFileLimit() {
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+int runEpollServer(Transport &transport, int threads, volatile sig_atomic_t &stopping,
+                   volatile sig_atomic_t &report) {
+    listener = &transport;
+    stopFlag = &stopping;
+    int listenSd = transport.listenFd();
+    fcntl(listenSd, F_SETFL, fcntl(listenSd, F_GETFL) | O_NONBLOCK);
+    raiseFileLimit();
+
+    // workers never take the signals, so they interrupt the main thread's sleep
+    sigset_t blocked, previous;
+    sigemptyset(&blocked);
+    sigaddset(&blocked, SIGINT);
+    sigaddset(&blocked, SIGTERM);
+    sigaddset(&blocked, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &blocked, &previous);
+
+    vector<Worker> workers(threads); // never resized while the threads run
+    int started = 0;
+    for (; started < threads; started++) {
+        Worker &w = workers[started];
+        pthread_mutex_init(&w.lock, nullptr);
+        w.epfd = epoll_create1(0);
+        struct epoll_event ev;
+        ev.events = EPOLLIN | EPOLLEXCLUSIVE; // wake one worker per connection
+        ev.data.ptr = nullptr;
+        if (w.epfd == -1 || epoll_ctl(w.epfd, EPOLL_CTL_ADD, listenSd, &ev) == -1 ||
+            pthread_create(&w.thread, nullptr, workerLoop, &w) != 0) {
+            cout << "Unable to start epoll worker: " << strerror(errno) << endl;
+            if (w.epfd != -1) close(w.epfd);
+            stopping = 1;
+            break;
+        }
+    }
+    pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+
+    if (started == threads) {
+        cout << "epoll server: " + to_string(threads) + " workers, SIGUSR1 prints a report" << endl;
+    }
+    while (!stopping) {
+        sleep(1); // returns early on a signal
+        if (report) {
+            report = 0;
+            printReport(workers, "Report");
+        }
+    }
+
+    for (int i = 0; i < started; i++) pthread_join(workers[i].thread, nullptr);
+    workers.resize(started);
+    printReport(workers, "Final report");
+    for (Worker &w : workers) {
+        for (EpollConnection *c : w.active) {
+            delete c->conn;
+            delete c;
+        }
+        close(w.epfd);
+        pthread_mutex_destroy(&w.lock);
+    }
+    return started == threads ? 0 : -1;
+}
@@ -0,0 +1,25 @@
+/**
+ * Author: Tanvir Tatla
+ * Description: Event-driven mode of the HW1 server for many simultaneous
+ *              clients. A fixed number of worker threads each run their own
+ *              epoll loop; all of them wait on the listening socket
+ *              (EPOLLEXCLUSIVE, so one is woken per connection) and serve the
+ *              connections they accept with non-blocking reads. Every
+ *              connection keeps its own statistics, and on request the server
+ *              prints the aggregate and the slowest connections.
+**/
+#ifndef _EPOLLSERVER_H_
+#define _EPOLLSERVER_H_
+
+#include "Transport.h" // Transport
+#include <csignal> // sig_atomic_t
+
+// runEpollServer serves transport's listening socket on threads workers
+// until stopping is set. Whenever report is set (e.g. by SIGUSR1) it prints
+// the aggregate so far and the slowest connections, then clears it; the
+// final report is printed on the way out. transport must be socket based.
+// Returns 0 on a clean stop, -1 if the workers could not be started.
+int runEpollServer(Transport &transport, int threads, volatile sig_atomic_t &stopping,
+                   volatile sig_atomic_t &report);
+
+#endif
@@ -0,0 +1,110 @@
+/**
+ * Author: Tanvir Tatla
+ * Description: Log-linear (HDR style) histogram, see Histogram.h
+**/
+#include "Histogram.h"
+#include <cmath> // sqrt
+#include <climits> // LLONG_MAX
+#include <cstdio> // snprintf
+
+using namespace std;
+
+const int SUB_BITS = 7; // 2^7 exact values, then 64 sub-buckets per power of two
+const int EXACT = 1 << SUB_BITS; // 128
+const int HALF = EXACT / 2; // 64
+const int NUM_BUCKETS = EXACT + (64 - SUB_BITS) * HALF; // enough for any long long
+
+Histogram::Histogram() : counts(NUM_BUCKETS, 0) {
+    clear();
+}
+
+void Histogram::clear() {
+    counts.assign(NUM_BUCKETS, 0);
+    total = 0;
+    minValue = LLONG_MAX;
+    maxValue = 0;
+    sum = sumSquares = 0;
+}
+
+// bucketOf maps a value to its bucket. Values >= 128 keep their top 7 bits:
+// shift is chosen so that value >> shift falls in [64, 127].
+int Histogram::bucketOf(long long value) {
+    if (value < EXACT) return (int) value;
+    int msb = 63 - __builtin_clzll((unsigned long long) value);
+    int shift = msb - (SUB_BITS - 1);
+    return EXACT + (shift - 1) * HALF + (int) ((value >> shift) - HALF);
+}
+
+long long Histogram::lowestOf(int bucket) {
+    if (bucket < EXACT) return bucket;
+    int shift = (bucket - EXACT) / HALF + 1;
+    long long sub = (bucket - EXACT) % HALF + HALF;
+    return sub << shift;
+}
+
+long long Histogram::highestOf(int bucket) {
+    if (bucket < EXACT) return bucket;
+    int shift = (bucket - EXACT) / HALF + 1;
+    return lowestOf(bucket) + (1LL << shift) - 1;
+}
+
+void Histogram::record(long long value) {
+    if (value < 0) value = 0;
+    counts[bucketOf(value)]++;
+    total++;
+    if (value < minValue) minValue = value;
+    if (value > maxValue) maxValue = value;
+    sum += value;
+    sumSquares += (double) value * value;
+}
+
+void Histogram::merge(const Histogram &other) {
+    for (int i = 0; i < NUM_BUCKETS; i++) counts[i] += other.counts[i];
+    total += other.total;
+    if (other.total && other.minValue < minValue) minValue = other.minValue;
+    if (other.maxValue > maxValue) maxValue = other.maxValue;
+    sum += other.sum;
+    sumSquares += other.sumSquares;
+}
+
+double Histogram::mean() const {
+    return total ? sum / total : 0;
+}
+
+double Histogram::stddev() const {
+    if (total < 2) return 0;
+    double m = mean();
+    double variance = sumSquares / total - m * m;
+    return variance > 0 ? sqrt(variance) : 0;
+}
+
+// percentile returns the highest value equivalent to the bucket holding the
+// p-th percentile, clamped to the recorded range
+long long Histogram::percentile(double p) const {
+    if (total == 0) return 0;
+    long long rank = (long long) ceil(p / 100.0 * total);
+    if (rank < 1) rank = 1;
+    long long seen = 0;
+    for (int i = 0; i < NUM_BUCKETS; i++) {
+        seen += counts[i];
+        if (seen >= rank) {
+            long long v = highestOf(i);
+            if (v > maxValue) v = maxValue;
+            if (v < minValue) v = minValue;
+            return v;
+        }
+    }
+    return maxValue;
+}
+
+void Histogram::printBuckets(ostream &out) const {
+    long long seen = 0;
+    for (int i = 0; i < NUM_BUCKETS; i++) {
+        if (counts[i] == 0) continue;
+        seen += counts[i];
+        char line[128];
+        snprintf(line, sizeof(line), "  [%lld, %lld] %lld (%.2f%%)",
+                 lowestOf(i), highestOf(i), counts[i], 100.0 * seen / total);
+        out << line << endl;
+    }
+}
@@ -0,0 +1,42 @@
+/**
+ * Author: Tanvir Tatla
+ * Description: Log-linear (HDR style) histogram of non-negative integers.
+ *              Values below 128 are counted exactly; above that every power
+ *              of two is split into 64 sub-buckets, so any recorded value is
+ *              reproduced within 1.6%. Recording is O(1) and allocation free.
+**/
+#ifndef _HISTOGRAM_H_
+#define _HISTOGRAM_H_
+
+#include <vector> // vector
+#include <string> // string
+#include <iostream> // ostream
+
+class Histogram {
+ public:
+    Histogram();
+    void record(long long value); // count one value (negative values count as 0)
+    void merge(const Histogram &other); // add other's counts to this histogram
+    void clear();
+
+    long long count() const { return total; }
+    long long min() const { return total ? minValue : 0; }
+    long long max() const { return maxValue; }
+    double mean() const;
+    double stddev() const;
+    long long percentile(double p) const; // p in [0, 100]
+
+    // print one line per non-empty bucket: low, high, count, cumulative %
+    void printBuckets(std::ostream &out) const;
+ private:
+    static int bucketOf(long long value);
+    static long long lowestOf(int bucket);
+    static long long highestOf(int bucket);
+
+    std::vector<long long> counts; // one counter per bucket
+    long long total; // number of recorded values
+    long long minValue, maxValue;
+    double sum, sumSquares; // for mean and standard deviation
+};
+
+#endif
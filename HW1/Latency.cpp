@@ -0,0 +1,57 @@
+/**
+ * Author: Tanvir Tatla
+ * Description: Per-iteration latency recording, see Latency.h
+**/
+#include "Latency.h"
+#include <iostream> // cout
+#include <fstream> // ofstream
+#include <cstdio> // snprintf
+#include <cstdlib> // llabs
+
+using namespace std;
+
+LatencyStats::LatencyStats(bool keepSamples)
+    : keep(keepSamples), previous(-1), jitterSum(0), jitterCount(0) {
+}
+
+void LatencyStats::record(long long ns) {
+    hist.record(ns);
+    if (keep) samples.push_back(ns);
+
+    // jitter is the mean change between consecutive iterations
+    if (previous >= 0) {
+        jitterSum += llabs(ns - previous);
+        jitterCount++;
+    }
+    previous = ns;
+}
+
+void LatencyStats::merge(const LatencyStats &other) {
+    hist.merge(other.hist);
+    if (keep) samples.insert(samples.end(), other.samples.begin(), other.samples.end());
+    jitterSum += other.jitterSum;
+    jitterCount += other.jitterCount;
+}
+
+void LatencyStats::print(const string &label) const {
+    if (hist.count() == 0) return;
+    char line[256];
+    snprintf(line, sizeof(line),
+             "%s latency (usec): min = %.3f, p50 = %.3f, p99 = %.3f, p99.9 = %.3f, "
+             "max = %.3f, mean = %.3f, stddev = %.3f, jitter = %.3f (n = %lld)",
+             label.c_str(), hist.min() / 1e3, hist.percentile(50) / 1e3,
+             hist.percentile(99) / 1e3, hist.percentile(99.9) / 1e3, hist.max() / 1e3,
+             hist.mean() / 1e3, hist.stddev() / 1e3,
+             jitterCount ? jitterSum / jitterCount / 1e3 : 0.0, hist.count());
+    cout << line << endl;
+}
+
+bool LatencyStats::dumpSamples(const string &path) const {
+    ofstream out(path);
+    if (!out) {
+        cout << "Unable to write " + path << endl;
+        return false;
+    }
+    for (long long ns : samples) out << ns << '\n';
+    return true;
+}
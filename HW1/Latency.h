@@ -0,0 +1,44 @@
+/**
+ * Author: Tanvir Tatla
+ * Description: Per-iteration latency recording for the HW1 programs. Each
+ *              sample is a CLOCK_MONOTONIC_RAW interval in nanoseconds; the
+ *              samples go into a Histogram and, optionally, a raw list that
+ *              can be dumped for plotting.
+**/
+#ifndef _LATENCY_H_
+#define _LATENCY_H_
+
+#include "Histogram.h"
+#include <time.h> // clock_gettime
+#include <string> // string
+#include <vector> // vector
+
+// monotonicNs returns CLOCK_MONOTONIC_RAW in nanoseconds. The raw clock is
+// not slewed by NTP, so short intervals are not stretched or shrunk.
+inline long long monotonicNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+class LatencyStats {
+ public:
+    explicit LatencyStats(bool keepSamples = false);
+    void record(long long ns); // add one iteration's latency
+    void merge(const LatencyStats &other); // combine (jitter is not merged)
+    const Histogram &histogram() const { return hist; }
+
+    // print min/p50/p99/p99.9/max, mean, stddev and jitter in usec
+    void print(const std::string &label) const;
+    // write the raw samples, one nanosecond value per line
+    bool dumpSamples(const std::string &path) const;
+ private:
+    Histogram hist;
+    bool keep; // keep raw samples for dumpSamples
+    std::vector<long long> samples;
+    long long previous; // last sample, for jitter
+    double jitterSum; // sum of |sample - previous sample|
+    long long jitterCount;
+};
+
+#endif
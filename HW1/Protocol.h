@@ -0,0 +1,121 @@
+/**
+ * Author: Tanvir Tatla
+ * Description: Test handshake shared by the HW1 client and server. The client
+ *              sends a TestHeader right after connecting so the server knows
+ *              how much data to expect and which write type produced it.
+**/
+#ifndef _PROTOCOL_H_
+#define _PROTOCOL_H_
+
+#include <stdint.h> // uint32_t
+#include <arpa/inet.h> // htonl, ntohl
+#include "Transport.h" // Connection
+
+// write types
+const int MULTIPLE_WRITES = 1;
+const int WRITEV = 2;
+const int SINGLE_WRITE = 3;
+const int ZEROCOPY_SEND = 4; // send( MSG_ZEROCOPY )
+const int SPLICE_WRITE = 5; // vmsplice into a pipe, splice pipe to socket
+const int SENDFILE_WRITE = 6; // sendfile from a tmpfs file
+const int NUM_TYPES = 6;
+
+const uint32_t TEST_MAGIC = 0x43535334; // "CSS4"
+
+// limits on what a TestHeader may ask of the server, which sizes its
+// buffers from these fields
+const uint32_t MAX_NBUFS = 64 * 1024; // buffers per message
+const long long MAX_MESSAGE_BYTES = 64LL * 1024 * 1024; // nbufs * bufsize
+const uint32_t MAX_REPETITION = 0x7fffffff; // the server compares it as an int
+const uint32_t MAX_ECHO_BYTES = 64 * 1024 * 1024; // reply to each message
+
+// TestHeader describes one test run. All fields travel in network byte order.
+struct TestHeader {
+    uint32_t magic; // TEST_MAGIC
+    uint32_t type; // write type used by the client
+    uint32_t nbufs; // number of data buffers per message
+    uint32_t bufsize; // size of each data buffer
+    uint32_t repetition; // number of messages
+    uint32_t rcvbuf; // SO_RCVBUF for the server's socket, (uint32_t) -1 for default
+    uint32_t busyPoll; // SO_BUSY_POLL usec for the server's socket, (uint32_t) -1 for default
+    uint32_t echoSize; // echo mode: bytes the server replies to each message, 0 = off
+};
+
+// typeName returns a short name for a write type
+inline const char *typeName(int type) {
+    static const char *names[] = { "unknown", "multiple-writes", "writev",
+        "single-write", "msg-zerocopy", "vmsplice-splice", "sendfile" };
+    return (type >= 1 && type <= NUM_TYPES) ? names[type] : names[0];
+}
+
+// readFully reads exactly length bytes unless the peer closes or an error
+// occurs. Returns true on success.
+inline bool readFully(Connection &conn, void *buf, size_t length) {
+    char *p = (char *) buf;
+    while (length > 0) {
+        ssize_t n = conn.read(p, length);
+        if (n <= 0) return false;
+        p += n;
+        length -= n;
+    }
+    return true;
+}
+
+// writeFully writes exactly length bytes. Returns true on success.
+inline bool writeFully(Connection &conn, const void *buf, size_t length) {
+    const char *p = (const char *) buf;
+    while (length > 0) {
+        ssize_t n = conn.write(p, length);
+        if (n <= 0) return false;
+        p += n;
+        length -= n;
+    }
+    return true;
+}
+
+// sendHeader writes header to conn in network byte order
+inline bool sendHeader(Connection &conn, TestHeader header) {
+    header.magic = htonl(header.magic);
+    header.type = htonl(header.type);
+    header.nbufs = htonl(header.nbufs);
+    header.bufsize = htonl(header.bufsize);
+    header.repetition = htonl(header.repetition);
+    header.rcvbuf = htonl(header.rcvbuf);
+    header.busyPoll = htonl(header.busyPoll);
+    header.echoSize = htonl(header.echoSize);
+    return writeFully(conn, &header, sizeof(header));
+}
+
+// validHeader checks the magic number and that every size is in range
+inline bool validHeader(const TestHeader &header) {
+    long long msgSize = (long long) header.nbufs * header.bufsize;
+    return header.magic == TEST_MAGIC &&
+           header.type >= 1 && header.type <= NUM_TYPES &&
+           header.nbufs >= 1 && header.nbufs <= MAX_NBUFS &&
+           header.bufsize >= 1 && msgSize <= MAX_MESSAGE_BYTES &&
+           header.repetition <= MAX_REPETITION &&
+           header.echoSize <= MAX_ECHO_BYTES;
+}
+
+// decodeHeader converts a header read off the wire to host byte order.
+// Returns false if the magic number does not match or a size is out of
+// range.
+inline bool decodeHeader(TestHeader &header) {
+    header.magic = ntohl(header.magic);
+    header.type = ntohl(header.type);
+    header.nbufs = ntohl(header.nbufs);
+    header.bufsize = ntohl(header.bufsize);
+    header.repetition = ntohl(header.repetition);
+    header.rcvbuf = ntohl(header.rcvbuf);
+    header.busyPoll = ntohl(header.busyPoll);
+    header.echoSize = ntohl(header.echoSize);
+    return validHeader(header);
+}
+
+// recvHeader reads a header from conn and converts it to host byte order.
+// Returns false if the read failed or the header is not valid.
+inline bool recvHeader(Connection &conn, TestHeader &header) {
+    return readFully(conn, &header, sizeof(header)) && decodeHeader(header);
+}
+
+#endif
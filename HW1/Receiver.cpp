@@ -0,0 +1,158 @@
+/**
+ * Author: Tanvir Tatla
+ * Description: Receive strategies for the HW1 server, see Receiver.h
+**/
+#include "Receiver.h"
+#include <iostream> // cout
+#include <cstring> // memset, strerror
+#include <cerrno> // errno
+#include <fcntl.h> // splice, open
+#include <unistd.h> // read, close, pipe
+#include <sys/socket.h> // recv, recvmmsg, setsockopt
+#include <climits> // IOV_MAX
+
+using namespace std;
+
+const char *strategyName(int strategy) {
+    static const char *names[] = { "unknown", "read", "waitall", "readv",
+        "recvmmsg", "splice", "lowat" };
+    return (strategy >= 1 && strategy <= NUM_STRATEGIES) ? names[strategy] : names[0];
+}
+
+int strategyFromName(const string &name) {
+    for (int s = 1; s <= NUM_STRATEGIES; s++) {
+        if (name == strategyName(s)) return s;
+    }
+    return 0;
+}
+
+// Constructor sets up what the strategy needs for this connection ------------
+Receiver::Receiver(int strategy, Connection &conn, const TestHeader &header)
+    : strategy(strategy), conn(conn), sd(conn.fd()), msgSize(header.nbufs * header.bufsize),
+      nbufs(header.nbufs), bufsize(header.bufsize), ok(true), devNull(-1), callCount(0) {
+    pipeFds[0] = pipeFds[1] = -1;
+
+    if (strategy != RECV_READ && sd == -1) {
+        cout << "Receive strategy " << strategyName(strategy) << " needs a socket" << endl;
+        ok = false;
+    } else if (strategy == RECV_SPLICE) {
+        devNull = open("/dev/null", O_WRONLY);
+        if (devNull == -1 || pipe(pipeFds) == -1) {
+            cout << "Unable to set up splice: " << strerror(errno) << endl;
+            ok = false;
+        }
+    } else if (strategy == RECV_LOWAT) {
+        // read( ) does not return until a whole message is queued (the kernel
+        // caps the value at half the receive buffer)
+        if (setsockopt(sd, SOL_SOCKET, SO_RCVLOWAT, &msgSize, sizeof(msgSize)) == -1) {
+            cout << "Unable to set SO_RCVLOWAT: " << strerror(errno) << endl;
+            ok = false;
+        }
+    } else if (strategy == RECV_READV || strategy == RECV_RECVMMSG) {
+        iov.resize(nbufs);
+        msgs.resize(nbufs);
+    }
+}
+
+Receiver::~Receiver() {
+    if (pipeFds[0] != -1) {
+        close(pipeFds[0]);
+        close(pipeFds[1]);
+    }
+    if (devNull != -1) close(devNull);
+}
+
+// count records one call that returned n bytes ------------------------------
+bool Receiver::count(long n) {
+    callCount++;
+    if (n <= 0) return false;
+    perCall.record(n);
+    return true;
+}
+
+// receiveMessage reads exactly one message with the selected strategy ------
+bool Receiver::receiveMessage(char *buf) {
+    switch (strategy) {
+    case RECV_WAITALL: return waitAllMessage(buf);
+    case RECV_READV: return readvMessage(buf);
+    case RECV_RECVMMSG: return recvmmsgMessage(buf);
+    case RECV_SPLICE: return spliceMessage();
+    default: return readMessage(buf); // RECV_READ and RECV_LOWAT
+    }
+}
+
+// readMessage is the original loop: read( ) whatever is there until done
+bool Receiver::readMessage(char *buf) {
+    for (int nRead = 0; nRead < msgSize; ) {
+        int n = conn.read(buf + nRead, msgSize - nRead);
+        if (!count(n)) return false;
+        nRead += n;
+    }
+    return true;
+}
+
+// waitAllMessage asks the kernel to block until the whole message is in
+bool Receiver::waitAllMessage(char *buf) {
+    for (int nRead = 0; nRead < msgSize; ) {
+        int n = recv(sd, buf + nRead, msgSize - nRead, MSG_WAITALL);
+        if (!count(n)) return false;
+        nRead += n;
+    }
+    return true;
+}
+
+// readvMessage scatters into nbufs buffers of bufsize, like the client's
+// writev; after a short read the list restarts at the first unfilled byte
+bool Receiver::readvMessage(char *buf) {
+    for (int nRead = 0; nRead < msgSize; ) {
+        int first = nRead / bufsize, used = 0;
+        for (int j = first; j < nbufs && used < IOV_MAX; j++, used++) {
+            int offset = (j == first) ? nRead % bufsize : 0;
+            iov[used].iov_base = buf + j * bufsize + offset;
+            iov[used].iov_len = bufsize - offset;
+        }
+        int n = readv(sd, &iov[0], used);
+        if (!count(n)) return false;
+        nRead += n;
+    }
+    return true;
+}
+
+// recvmmsgMessage receives into one mmsghdr per remaining buffer in a single
+// call. MSG_WAITFORONE blocks for the first entry only, so on a stream
+// socket each call returns whatever is queued, split across the entries.
+bool Receiver::recvmmsgMessage(char *buf) {
+    for (int nRead = 0; nRead < msgSize; ) {
+        int first = nRead / bufsize, used = 0;
+        for (int j = first; j < nbufs && used < IOV_MAX; j++, used++) {
+            int offset = (j == first) ? nRead % bufsize : 0;
+            iov[used].iov_base = buf + j * bufsize + offset;
+            iov[used].iov_len = bufsize - offset;
+            memset(&msgs[used], 0, sizeof(msgs[used]));
+            msgs[used].msg_hdr.msg_iov = &iov[used];
+            msgs[used].msg_hdr.msg_iovlen = 1;
+        }
+        int entries = recvmmsg(sd, &msgs[0], used, MSG_WAITFORONE, nullptr);
+        long n = 0;
+        for (int j = 0; j < entries; j++) n += msgs[j].msg_len;
+        if (!count(entries > 0 ? n : entries)) return false;
+        nRead += n;
+    }
+    return true;
+}
+
+// spliceMessage moves the message into a pipe and from there to /dev/null,
+// so the payload never enters user space
+bool Receiver::spliceMessage() {
+    for (int nRead = 0; nRead < msgSize; ) {
+        ssize_t n = splice(sd, nullptr, pipeFds[1], nullptr, msgSize - nRead, SPLICE_F_MOVE);
+        if (!count(n)) return false;
+        nRead += n;
+        for (ssize_t left = n; left > 0; ) {
+            ssize_t m = splice(pipeFds[0], nullptr, devNull, nullptr, left, SPLICE_F_MOVE);
+            if (m <= 0) return false;
+            left -= m;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,61 @@
+/**
+ * Author: Tanvir Tatla
+ * Description: Receive strategies for the HW1 server. Each strategy reads
+ *              one client message of nbufs * bufsize bytes with a different
+ *              system call pattern and records how many bytes every call
+ *              returned, so the cheapest receive path can be picked.
+ *              Only read works on every transport; the others need a socket,
+ *              and recvmmsg also splits seqpacket records.
+**/
+#ifndef _RECEIVER_H_
+#define _RECEIVER_H_
+
+#include "Histogram.h"
+#include "Protocol.h" // TestHeader
+#include <string> // string
+#include <vector> // vector
+#include <sys/uio.h> // iovec
+#include <sys/socket.h> // mmsghdr
+
+// receive strategies
+const int RECV_READ = 1; // read( ) until the message is complete
+const int RECV_WAITALL = 2; // recv( MSG_WAITALL ), normally one call
+const int RECV_READV = 3; // readv( ) scattered into the client's nbufs buffers
+const int RECV_RECVMMSG = 4; // recvmmsg( ) with one entry per buffer
+const int RECV_SPLICE = 5; // splice( ) socket -> pipe -> /dev/null, no user copy
+const int RECV_LOWAT = 6; // read( ) with SO_RCVLOWAT set to the message size
+const int NUM_STRATEGIES = 6;
+
+const char *strategyName(int strategy);
+int strategyFromName(const std::string &name); // 0 if unknown
+
+class Receiver {
+ public:
+    Receiver(int strategy, Connection &conn, const TestHeader &header);
+    ~Receiver();
+    bool ready() const { return ok; } // setup (pipe, socket option) succeeded
+    bool receiveMessage(char *buf); // false if the peer closed or an error occurred
+    long calls() const { return callCount; }
+    const Histogram &bytesPerCall() const { return perCall; }
+ private:
+    bool count(long n); // record one call's result, true if data was returned
+    bool readMessage(char *buf);
+    bool waitAllMessage(char *buf);
+    bool readvMessage(char *buf);
+    bool recvmmsgMessage(char *buf);
+    bool spliceMessage();
+
+    int strategy;
+    Connection &conn;
+    int sd; // conn's socket, -1 if it has none
+    int msgSize, nbufs, bufsize;
+    bool ok;
+    int pipeFds[2]; // splice: socket -> pipe
+    int devNull; // splice: pipe -> /dev/null
+    Histogram perCall; // bytes returned by each call
+    long callCount;
+    std::vector<struct iovec> iov; // readv / recvmmsg scatter list
+    std::vector<struct mmsghdr> msgs; // recvmmsg entries
+};
+
+#endif
@@ -17,14 +17,48 @@
 #include <netinet/tcp.h> // SO_REUSEADDR
 #include <sys/uio.h> // writev
 #include <sys/time.h> // timeval and timersub
+#include <csignal> // sigaction, pthread_sigmask
+#include <vector> // vector
+#include "Protocol.h" // TestHeader, typeName
+#include "Latency.h" // LatencyStats, monotonicNs
+#include "Receiver.h" // receive strategies
+#include "TcpInfo.h" // TcpInfoSampler
+#include "SocketOptions.h" // applyReceiverOptions
+#include "Transport.h" // Transport, Connection
+#include "CpuCost.h" // CpuCost
+#include "EpollServer.h" // runEpollServer
+#include <pthread.h> // pthread_create, pthread_mutex_t
 
 using namespace std;
 
-const int BUFSIZE = 1500;
-const int NUM_CONNECTIONS = 10;
+const int NUM_CONNECTIONS = 4096; // listen backlog, capped by net.core.somaxconn
+
+volatile sig_atomic_t stopping = 0; // set by SIGINT/SIGTERM to leave the accept loop
+volatile sig_atomic_t reportRequested = 0; // set by SIGUSR1 in epoll mode
 
 int port; // server's port number
-int repetition; // the repetition of client's data transmission activities. Should be same as client.
+int repetition; // the repetition of client's data transmission activities. The client's
+                // TestHeader is authoritative; a mismatch is reported.
+string dumpPrefix; // -d: raw per-message latency goes to <prefix>.<connection>
+int connections = 0; // connections served so far, numbers the dump files
+int strategy = RECV_READ; // -r: how evaluatePerformance receives each message
+int infoInterval = 0; // -i: TCP_INFO sampling interval in ms, 0 = off
+string transportName = "tcp"; // -T: tcp, unix, seqpacket or shm
+int epollThreads = 0; // -e: serve with this many epoll workers instead of a thread per client
+
+// Connections that overlap in time (e.g. a client run with -P n) form a
+// group. The group lasts while at least one evaluatePerformance thread is
+// still receiving; the last one to finish prints the group's aggregate.
+struct Group {
+    int active; // threads still receiving
+    int members; // connections that joined since the group started
+    struct timeval first, last; // earliest start, latest stop
+    long bytes; // bytes received by all members
+    double sum, sumSquares; // per-connection Gbit/s, for Jain's index
+    LatencyStats latency; // all members' per-message latencies
+};
+Group group;
+pthread_mutex_t groupLock = PTHREAD_MUTEX_INITIALIZER; // guards group and cout
 
 // validates the 2 arguments passed into main
 // port must be between 1024 and 65535
@@ -56,133 +90,314 @@ bool validateArgs(char *args[]) {
     return true;
 }
 
+// parseOptions handles the optional flags that follow port and repetition.
+// Returns false on an unknown flag or a missing value.
+//   -d prefix   write each connection's per-message latency (ns) to prefix.N
+//   -r name     receive strategy: read (default), waitall, readv, recvmmsg,
+//               splice or lowat (recvmmsg not with -T seqpacket)
+//   -i ms       sample TCP_INFO every ms milliseconds while receiving
+//   -T name     transport: tcp (default), unix, seqpacket or shm
+//   -e threads  event-driven mode for many clients: a fixed number of epoll
+//               workers, per-connection statistics, and a report of the
+//               aggregate and the slowest connections on SIGUSR1 and at exit
+//               (reads only, no per-message latency; not with -T shm)
+bool parseOptions(int numArgs, char *args[]) {
+    for (int i = 3; i < numArgs; i++) {
+        string flag = args[i];
+        if (i + 1 >= numArgs) {
+            cout << "Missing value for " + flag << endl;
+            return false;
+        }
+        if (flag == "-d") {
+            dumpPrefix = args[++i];
+        } else if (flag == "-i") {
+            infoInterval = atoi(args[++i]);
+        } else if (flag == "-T") {
+            transportName = args[++i];
+        } else if (flag == "-e") {
+            epollThreads = atoi(args[++i]);
+            if (epollThreads < 1) {
+                cout << "Number of epoll workers must be at least 1" << endl;
+                return false;
+            }
+        } else if (flag == "-r") {
+            strategy = strategyFromName(args[++i]);
+            if (strategy == 0) {
+                cout << "Unknown receive strategy " + string(args[i]) << endl;
+                return false;
+            }
+        } else {
+            cout << "Unknown option " + flag << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
 // printStatistics calculates the time taken to receive all data from client
-// and prints the receiving time. 
-void printStatistics(struct timeval start, struct timeval stop) {
+// and prints the receiving time together with what the client's write type
+// and the receive strategy cost on this side: bytes received, receive calls,
+// throughput and the distribution of bytes returned per call.
+void printStatistics(struct timeval start, struct timeval stop, const TestHeader &header,
+                     long bytes, const Receiver &receiver) {
     struct timeval rec;
     timersub(&stop, &start, &rec); //get diff between stop and start, assign diff to rec
     long receiveTime = rec.tv_sec * 1000000L + rec.tv_usec; // time in microseconds
-    cout << "data-receiving time = " + to_string(receiveTime) + " usec" << endl;
+    double mbps = receiveTime > 0 ? (double) bytes / receiveTime : 0; // bytes/usec = MB/s
+    long count = receiver.calls();
+    cout << "type = " + string(typeName(header.type)) + ", ";
+    cout << "strategy = " + string(strategyName(strategy)) + ", ";
+    cout << "data-receiving time = " + to_string(receiveTime) + " usec, ";
+    cout << "bytes = " + to_string(bytes) + ", #reads = " + to_string(count) + ", ";
+    cout << "bytes/read = " + to_string(count > 0 ? bytes / count : 0) + ", ";
+    cout << "throughput = " + to_string(mbps) + " MB/s" << endl;
+
+    const Histogram &perCall = receiver.bytesPerCall();
+    cout << "bytes per call: min = " + to_string(perCall.min());
+    cout << ", p50 = " + to_string(perCall.percentile(50));
+    cout << ", p90 = " + to_string(perCall.percentile(90));
+    cout << ", max = " + to_string(perCall.max()) << endl;
+    perCall.printBuckets(cout);
+}
+
+// elapsedUsec returns b - a in microseconds
+long elapsedUsec(struct timeval a, struct timeval b) {
+    struct timeval diff;
+    timersub(&b, &a, &diff);
+    return diff.tv_sec * 1000000L + diff.tv_usec;
+}
+
+// joinGroup adds a connection that started receiving at start to the
+// current group, starting a new group if none is active
+void joinGroup(struct timeval start) {
+    pthread_mutex_lock(&groupLock);
+    if (group.active == 0) {
+        group = Group();
+        group.first = start;
+    }
+    if (timercmp(&start, &group.first, <)) group.first = start;
+    group.active++;
+    group.members++;
+    pthread_mutex_unlock(&groupLock);
+}
+
+// leaveGroup records a finished connection. When it was the last active one
+// and the group had more than one member, it prints the aggregate throughput
+// over the group's wall time and Jain's fairness index,
+// (sum x)^2 / (n * sum x^2). Caller must hold groupLock.
+void leaveGroup(struct timeval start, struct timeval stop, long bytes,
+                const LatencyStats &latency) {
+    long usec = elapsedUsec(start, stop);
+    double gbps = usec > 0 ? bytes * 8.0 / usec / 1e3 : 0;
+    group.bytes += bytes;
+    group.sum += gbps;
+    group.sumSquares += gbps * gbps;
+    group.latency.merge(latency);
+    if (group.members == 1 || timercmp(&stop, &group.last, >)) group.last = stop;
+    if (--group.active > 0 || group.members < 2) return;
+
+    long wall = elapsedUsec(group.first, group.last);
+    double aggregate = wall > 0 ? group.bytes * 8.0 / wall / 1e3 : 0;
+    double jain = group.sumSquares > 0 ? group.sum * group.sum / (group.members * group.sumSquares) : 0;
+    cout << "Aggregate: connections = " + to_string(group.members);
+    cout << ", bytes = " + to_string(group.bytes);
+    cout << ", wall time = " + to_string(wall) + " usec";
+    cout << ", throughput = " + to_string(aggregate) + " Gbit/s";
+    cout << ", Jain's fairness = " + to_string(jain) << endl;
+    group.latency.print("all connections per-message");
 }
 
-// evaluatePerformance records the time the server starts reading client's data
-// and the time it finishes reading data. Then it sends the number of times the
-// server called read( ) to the client. Finally, it prints the time takne to read
-// all incoming data, and closes the connection to client. 
-// evaluatePerformance is called by a pthread. 
+// evaluatePerformance reads the client's TestHeader, records the time the
+// server starts reading client's data and the time it finishes reading data.
+// In echo mode (header.echoSize > 0) every message is answered right away
+// with echoSize bytes, so the client can time each round trip.
+// Then it sends the number of times the server called read( ) to the client.
+// Finally, it prints the time taken to read all incoming data, and closes the
+// connection to client.
+// evaluatePerformance is called by a pthread and owns the Connection it is
+// given.
 void *evaluatePerformance(void *data) {
-    int sd = *(int*) data;
-    char databuf[BUFSIZE];
-    int count = 0; // number of reads
+    Connection *conn = (Connection *) data;
+    int sd = conn->fd(); // -1 for the shared-memory ring
+    TestHeader header;
+
+    if (!recvHeader(*conn, header)) {
+        cout << "Invalid test header from client" << endl;
+        delete conn;
+        return nullptr;
+    }
+
+    // receive-side socket options chosen by the client (-b, -B)
+    if (sd != -1) applyReceiverOptions(sd, (int) header.rcvbuf, (int) header.busyPoll);
+
+    if ((int) header.repetition != repetition) {
+        cout << "Client repetition " + to_string(header.repetition) + " overrides "
+            + to_string(repetition) << endl;
+    }
+
+    // bytes per repetition, at most MAX_MESSAGE_BYTES since recvHeader
+    // checked the header
+    int msgSize = (int) ((long long) header.nbufs * header.bufsize);
+    vector<char> databuf(msgSize);
+    vector<char> reply(header.echoSize, 'y'); // echo mode response
+    if (header.echoSize > 0 && sd != -1) {
+        // a reply must not wait on Nagle for the ack of the previous one
+        int yes = 1;
+        setsockopt(sd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+    }
+    Receiver receiver(strategy, *conn, header); // counts receive calls
+    long bytes = 0; // total bytes received
+    bool closed = false; // client went away early
+    int connection = __sync_fetch_and_add(&connections, 1);
+    LatencyStats latency(!dumpPrefix.empty()); // time to receive each message
     struct timeval start, stop;
     gettimeofday(&start , NULL); // record start time
+    joinGroup(start);
+    TcpInfoSampler tcpInfo;
+    if (sd != -1) tcpInfo.start(sd, infoInterval);
+    CpuCost cpu; // this thread's cycles and system calls while receiving
+    cpu.start();
 
     // repeat same number of repetitions as client.
-    for (int i = 0; i < repetition; i++) {
-        for ( int nRead = 0; 
-            ( nRead += read( sd, databuf, BUFSIZE - nRead ) ) < BUFSIZE; 
-            ++count );
-        count++;
+    for (uint32_t i = 0; i < header.repetition && !closed; i++) {
+        long long begin = monotonicNs();
+        if (!receiver.ready() || !receiver.receiveMessage(&databuf[0])) {
+            closed = true;
+            break;
+        }
+        bytes += msgSize;
+        latency.record(monotonicNs() - begin);
+        if (!reply.empty() && !writeFully(*conn, &reply[0], reply.size())) {
+            closed = true;
+            break;
+        }
     }
-    
+
     gettimeofday(&stop , NULL); // record end time
-    int temp = htonl(count);
-    write(sd, &temp, sizeof(temp)); // send number of reads
-    printStatistics(start, stop); // print receive times
-    close(sd); // close connection
+    cpu.stop();
+    tcpInfo.stop();
+    int temp = htonl(receiver.calls());
+    writeFully(*conn, &temp, sizeof(temp)); // send number of reads
+
+    pthread_mutex_lock(&groupLock); // keep each connection's report together
+    printStatistics(start, stop, header, bytes, receiver); // print receive times
+    latency.print("per-message");
+    tcpInfo.print("server connection " + to_string(connection));
+    long messages = msgSize > 0 ? bytes / msgSize : 0;
+    long ioCalls = receiver.calls() + (reply.empty() ? 0 : messages); // one write per reply
+    cpu.print("connection " + to_string(connection), bytes, messages, ioCalls);
+    leaveGroup(start, stop, bytes, latency);
+    pthread_mutex_unlock(&groupLock);
+    if (!dumpPrefix.empty()) latency.dumpSamples(dumpPrefix + "." + to_string(connection));
+    delete conn; // close connection
+    return nullptr;
+}
+
+// stopServer is the SIGINT/SIGTERM handler. It only sets a flag so that
+// main returns normally (flushing output and any profile data).
+void stopServer(int) {
+    stopping = 1;
 }
 
-// main creates a TCP socket that listens on the port given as an argument. 
+// requestReport is the SIGUSR1 handler of epoll mode
+void requestReport(int) {
+    reportRequested = 1;
+}
+
+// installSignals makes SIGINT and SIGTERM interrupt accept( ) instead of
+// killing the process, and in epoll mode SIGUSR1 ask for a report
+void installSignals() {
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = stopServer; // no SA_RESTART so accept( ) returns EINTR
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+    if (epollThreads > 0) {
+        sa.sa_handler = requestReport;
+        sigaction(SIGUSR1, &sa, nullptr);
+    }
+}
+
+// main listens on the port given as an argument, over TCP unless -T picks
+// another transport. 
 // The server will accept an incoming connection and then create a new
 // thread that will handle the connection. The new thread will read all the 
 // data from the client and respond back to it. The details of the response 
 // can be found in the evaluatePerformance function. 
 // Returns 0 on success, or -1 on failure.
 // numArgs is the number of arguments passed, *args[] is the arguments
-// args must be formatted as ./ProgramName port repetition
+// args must be formatted as ./ProgramName port repetition [options]
 int main(int numArgs, char *args[]) {
-    if (numArgs != 3)
+    if (numArgs < 3)
     {
         cout << "Incorrect number of arguments provided" << endl;
         return -1;
     }
 
-    if (!validateArgs(args)) {
+    if (!validateArgs(args) || !parseOptions(numArgs, args)) {
         cout << "One or more arguments was invalid." << endl;
         return -1;
     }
 
-    struct addrinfo hints, *res; // res is a list of addresses
-    memset( &hints, 0, sizeof (hints) );
-    hints.ai_family = AF_UNSPEC;
-    hints.ai_socktype = SOCK_STREAM;
-    hints.ai_flags = AI_PASSIVE;
-    int status = getaddrinfo(NULL, args[1], &hints, &res);
-
-    if (status != 0) {
-        cout << gai_strerror(status) << endl;
+    Transport *transport = makeTransport(transportName);
+    if (!transport) {
+        cout << "Unknown transport " + transportName << endl;
         return -1;
     }
 
-    struct addrinfo *p; // current address
-    int serverSd, optResult, bindResult;
-    
-    // iterate over list of addresses.
-    for (p = res; p != nullptr; p = res->ai_next) {
-        // create TCP socket
-        serverSd = socket(p->ai_family, p->ai_socktype, p->ai_protocol);
-
-        if (serverSd == -1) continue;
-
-        // set socket option
-        const int yes = 1;
-        optResult = setsockopt( serverSd, SOL_SOCKET, SO_REUSEADDR, (char *)&yes,sizeof( yes ) );
-
-        if (optResult == -1) continue;
-
-        bindResult = bind( serverSd, p->ai_addr, p->ai_addrlen );
-
-        if (bindResult == -1) {
-            close(serverSd);
-            continue;
-        }
-
-        break; // success
+    if (epollThreads > 0 && transport->name() == string("shm")) {
+        cout << "Epoll mode needs a socket transport" << endl;
+        return -1;
     }
 
-    if (!p) {
-        cout << "Unable to connect" << endl;
+    // a recvmmsg entry holds one whole seqpacket record and cuts it to the
+    // entry's bufsize, so a record larger than one buffer would be lost
+    if (strategy == RECV_RECVMMSG && transport->name() == string("seqpacket")) {
+        cout << "Receive strategy recvmmsg cannot be used with -T seqpacket" << endl;
         return -1;
     }
 
-    freeaddrinfo(res);
-    int listenResult = listen(serverSd, NUM_CONNECTIONS); // prepare to accept connections
+    // prepare to accept connections
+    if (!transport->listen(port, NUM_CONNECTIONS)) return -1;
 
-    if (listenResult == -1) {
-        cout << "Unable to listen." << endl;
-        return -1;
+    installSignals();
+    if (epollThreads > 0) {
+        int result = runEpollServer(*transport, epollThreads, stopping, reportRequested);
+        delete transport;
+        return result;
     }
 
-    // run indefinitely to accept incoming connections
-    while (true) {
-        struct sockaddr_storage newSockAddr;
-        socklen_t newSockAddrSize = sizeof( newSockAddr );
-        // await connection request, open new socket upon connection
-        int newSd = accept( serverSd, (struct sockaddr *)&newSockAddr, &newSockAddrSize );
+    // client threads start with SIGINT and SIGTERM blocked, so the signals
+    // always reach this thread and interrupt accept( )
+    sigset_t stopSignals, previous;
+    sigemptyset(&stopSignals);
+    sigaddset(&stopSignals, SIGINT);
+    sigaddset(&stopSignals, SIGTERM);
+
+    // run until interrupted to accept incoming connections
+    while (!stopping) {
+        // await connection request, open new connection
+        Connection *conn = transport->accept();
 
-        if (newSd == -1) {
+        if (!conn) {
+            if (stopping) break;
             cout << "Unable to accept client connection request." << endl;
             continue;
         }
 
         pthread_t thread; // thread to handle new client
-        int result = pthread_create(&thread, nullptr, evaluatePerformance, (void*) &newSd);
+        pthread_sigmask(SIG_BLOCK, &stopSignals, &previous);
+        int result = pthread_create(&thread, nullptr, evaluatePerformance, conn);
+        pthread_sigmask(SIG_SETMASK, &previous, nullptr);
 
         if (result != 0) {
             cout << "Unable to create thread." << endl;
+            delete conn;
             continue;
         }
+        pthread_detach(thread); // nobody joins; release its resources on exit
     }
 
+    delete transport;
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,57 @@
+/**
+ * Author: Tanvir Tatla
+ * Description: Socket option handling for the HW1 benchmarks, see SocketOptions.h
+**/
+#include "SocketOptions.h"
+#include <iostream> // cout
+#include <cstring> // strerror
+#include <cerrno> // errno
+#include <sys/socket.h> // setsockopt
+#include <netinet/in.h> // IPPROTO_TCP
+#include <netinet/tcp.h> // TCP_NODELAY, TCP_CORK, TCP_NOTSENT_LOWAT
+
+#ifndef SO_BUSY_POLL
+#define SO_BUSY_POLL 46
+#endif
+
+using namespace std;
+
+// setOption sets one integer option if value is not -1
+static bool setOption(int sd, int level, int name, int value, const char *label) {
+    if (value < 0) return true;
+    if (setsockopt(sd, level, name, &value, sizeof(value)) == -1) {
+        cout << "Unable to set " << label << "=" << value << ": " << strerror(errno) << endl;
+        return false;
+    }
+    return true;
+}
+
+bool applySenderOptions(int sd, const SocketOptions &opts) {
+    bool ok = setOption(sd, IPPROTO_TCP, TCP_NODELAY, opts.nodelay, "TCP_NODELAY");
+    ok &= setOption(sd, SOL_SOCKET, SO_SNDBUF, opts.sndbuf, "SO_SNDBUF");
+    ok &= setOption(sd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, opts.notsentLowat, "TCP_NOTSENT_LOWAT");
+    ok &= setOption(sd, SOL_SOCKET, SO_BUSY_POLL, opts.busyPoll, "SO_BUSY_POLL");
+    return ok;
+}
+
+bool applyReceiverOptions(int sd, int rcvbuf, int busyPoll) {
+    bool ok = setOption(sd, SOL_SOCKET, SO_RCVBUF, rcvbuf, "SO_RCVBUF");
+    ok &= setOption(sd, SOL_SOCKET, SO_BUSY_POLL, busyPoll, "SO_BUSY_POLL");
+    return ok;
+}
+
+void setCork(int sd, bool on) {
+    int value = on ? 1 : 0;
+    setsockopt(sd, IPPROTO_TCP, TCP_CORK, &value, sizeof(value));
+}
+
+string describe(const SocketOptions &opts) {
+    static const char *corks[] = { "off", "tcp", "msg_more" };
+    string label = "nodelay=" + (opts.nodelay < 0 ? string("default") : to_string(opts.nodelay));
+    label += " cork=" + string(corks[opts.cork]);
+    label += " sndbuf=" + (opts.sndbuf < 0 ? string("default") : to_string(opts.sndbuf));
+    label += " rcvbuf=" + (opts.rcvbuf < 0 ? string("default") : to_string(opts.rcvbuf));
+    label += " notsent_lowat=" + (opts.notsentLowat < 0 ? string("default") : to_string(opts.notsentLowat));
+    label += " busy_poll=" + (opts.busyPoll < 0 ? string("default") : to_string(opts.busyPoll));
+    return label;
+}
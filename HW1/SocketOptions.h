@@ -0,0 +1,39 @@
+/**
+ * Author: Tanvir Tatla
+ * Description: Socket options the HW1 benchmarks can turn on, so their
+ *              effect on each write strategy can be measured. A value of -1
+ *              leaves the kernel default in place.
+**/
+#ifndef _SOCKETOPTIONS_H_
+#define _SOCKETOPTIONS_H_
+
+#include <string> // string
+
+// cork modes
+const int CORK_OFF = 0;
+const int CORK_TCP = 1; // TCP_CORK around each message
+const int CORK_MSG_MORE = 2; // MSG_MORE on every buffer but the last
+
+struct SocketOptions {
+    int nodelay; // TCP_NODELAY: 1 disables Nagle
+    int cork; // CORK_OFF, CORK_TCP or CORK_MSG_MORE
+    int sndbuf; // SO_SNDBUF bytes (client)
+    int rcvbuf; // SO_RCVBUF bytes (server, sent in the TestHeader)
+    int notsentLowat; // TCP_NOTSENT_LOWAT bytes (client)
+    int busyPoll; // SO_BUSY_POLL usec (both sides)
+    SocketOptions() : nodelay(-1), cork(CORK_OFF), sndbuf(-1), rcvbuf(-1),
+                      notsentLowat(-1), busyPoll(-1) {}
+};
+
+// applySenderOptions sets the sending side's options on sd. Call before
+// connect( ) so the buffer sizes take part in window scaling. Failures are
+// reported and ignored. Returns false if any option failed.
+bool applySenderOptions(int sd, const SocketOptions &opts);
+// applyReceiverOptions sets SO_RCVBUF and SO_BUSY_POLL on an accepted socket
+bool applyReceiverOptions(int sd, int rcvbuf, int busyPoll);
+// setCork turns TCP_CORK on or off
+void setCork(int sd, bool on);
+// describe returns a short label such as "nodelay=1 cork=tcp sndbuf=262144"
+std::string describe(const SocketOptions &opts);
+
+#endif
@@ -0,0 +1,122 @@
+/**
+ * Author: Tanvir Tatla
+ * Description: Periodic TCP_INFO sampling, see TcpInfo.h
+**/
+#include "TcpInfo.h"
+#include "Latency.h" // monotonicNs
+#include <iostream> // cout
+#include <cstring> // memset
+#include <cstdio> // snprintf
+#include <algorithm> // min, max
+#include <unistd.h> // usleep
+#include <sys/socket.h> // getsockopt
+#include <netinet/in.h> // IPPROTO_TCP
+#include <linux/tcp.h> // struct tcp_info with the newer fields
+
+using namespace std;
+
+TcpInfoSampler::TcpInfoSampler() : sd(-1), intervalMs(0), startNs(0), running(false) {
+    pthread_mutex_init(&lock, nullptr);
+}
+
+TcpInfoSampler::~TcpInfoSampler() {
+    stop();
+    pthread_mutex_destroy(&lock);
+}
+
+bool TcpInfoSampler::sample(int sd, TcpSample &out) {
+    struct tcp_info info;
+    memset(&info, 0, sizeof(info)); // older kernels fill only a prefix
+    socklen_t length = sizeof(info);
+    if (getsockopt(sd, IPPROTO_TCP, TCP_INFO, &info, &length) == -1) return false;
+
+    out.rtt = info.tcpi_rtt;
+    out.rttvar = info.tcpi_rttvar;
+    out.cwnd = info.tcpi_snd_cwnd;
+    out.ssthresh = info.tcpi_snd_ssthresh;
+    out.unacked = info.tcpi_unacked;
+    out.retrans = info.tcpi_total_retrans;
+    out.sndWnd = info.tcpi_snd_wnd;
+    out.notsent = info.tcpi_notsent_bytes;
+    out.deliveryRate = info.tcpi_delivery_rate;
+    out.busy = info.tcpi_busy_time;
+    out.rwndLimited = info.tcpi_rwnd_limited;
+    out.sndbufLimited = info.tcpi_sndbuf_limited;
+    return true;
+}
+
+void TcpInfoSampler::start(int socket, int interval) {
+    if (interval <= 0 || running) return;
+    sd = socket;
+    intervalMs = interval;
+    startNs = monotonicNs();
+    samples.clear();
+    running = true;
+    if (pthread_create(&thread, nullptr, run, this) != 0) {
+        cout << "Unable to start TCP_INFO sampler" << endl;
+        running = false;
+    }
+}
+
+void *TcpInfoSampler::run(void *self) {
+    TcpInfoSampler *s = (TcpInfoSampler *) self;
+    while (s->running) {
+        TcpSample sample;
+        if (TcpInfoSampler::sample(s->sd, sample)) {
+            sample.usec = (monotonicNs() - s->startNs) / 1000;
+            pthread_mutex_lock(&s->lock);
+            s->samples.push_back(sample);
+            pthread_mutex_unlock(&s->lock);
+        }
+        usleep(s->intervalMs * 1000);
+    }
+    return nullptr;
+}
+
+void TcpInfoSampler::stop() {
+    if (!running) return;
+    running = false;
+    pthread_join(thread, nullptr);
+
+    TcpSample last; // state at the end of the transfer
+    if (sample(sd, last)) {
+        last.usec = (monotonicNs() - startNs) / 1000;
+        samples.push_back(last);
+    }
+}
+
+void TcpInfoSampler::print(const string &label) const {
+    if (samples.empty()) return;
+    char line[256];
+
+    cout << label + " TCP_INFO every " + to_string(intervalMs) + " ms:" << endl;
+    cout << "      usec    rtt rttvar   cwnd   ssthresh unacked retrans  snd_wnd notsent"
+            "  rate(Mbit/s)  busy(us) rwnd_lim sndbuf_lim" << endl;
+    for (const TcpSample &s : samples) {
+        snprintf(line, sizeof(line), "%10lld %6u %6u %6u %10u %7u %7u %8u %7u %13.2f %9llu %8llu %10llu",
+                 s.usec, s.rtt, s.rttvar, s.cwnd, s.ssthresh, s.unacked, s.retrans, s.sndWnd,
+                 s.notsent, s.deliveryRate * 8 / 1e6, s.busy, s.rwndLimited, s.sndbufLimited);
+        cout << line << endl;
+    }
+
+    // summary: rtt range, cwnd peak, retransmits during the run, and how much
+    // of the busy time was spent limited by the receiver or the send buffer
+    unsigned rttMin = samples[0].rtt, rttMax = 0, cwndMax = 0;
+    double rttSum = 0;
+    for (const TcpSample &s : samples) {
+        rttMin = min(rttMin, s.rtt);
+        rttMax = max(rttMax, s.rtt);
+        cwndMax = max(cwndMax, s.cwnd);
+        rttSum += s.rtt;
+    }
+    const TcpSample &first = samples.front(), &last = samples.back();
+    double busy = last.busy > 0 ? (double) last.busy : 1;
+    snprintf(line, sizeof(line),
+             "%s TCP_INFO summary: rtt min/avg/max = %u/%.0f/%u usec, max cwnd = %u, "
+             "retransmits = %u, rwnd-limited = %.1f%%, sndbuf-limited = %.1f%%, "
+             "last delivery rate = %.2f Mbit/s",
+             label.c_str(), rttMin, rttSum / samples.size(), rttMax, cwndMax,
+             last.retrans - first.retrans, 100.0 * last.rwndLimited / busy,
+             100.0 * last.sndbufLimited / busy, last.deliveryRate * 8 / 1e6);
+    cout << line << endl;
+}
@@ -0,0 +1,52 @@
+/**
+ * Author: Tanvir Tatla
+ * Description: Periodic TCP_INFO sampling for the HW1 programs. A sampler
+ *              thread reads getsockopt( TCP_INFO ) every interval while a
+ *              transfer runs, so slow runs can be blamed on rtt, cwnd,
+ *              retransmits, the receive window or the send buffer.
+**/
+#ifndef _TCPINFO_H_
+#define _TCPINFO_H_
+
+#include <vector> // vector
+#include <string> // string
+#include <pthread.h> // pthread_t
+#include <atomic> // atomic
+
+// TcpSample is the subset of struct tcp_info we report. Fields the running
+// kernel does not provide stay 0.
+struct TcpSample {
+    long long usec; // time since the sampler started
+    unsigned rtt, rttvar; // smoothed rtt and its variance, usec
+    unsigned cwnd, ssthresh; // congestion window and threshold, segments
+    unsigned unacked; // segments in flight
+    unsigned retrans; // total retransmitted segments
+    unsigned sndWnd; // peer's advertised receive window, bytes
+    unsigned notsent; // bytes queued but not yet sent
+    unsigned long long deliveryRate; // bytes/sec
+    unsigned long long busy, rwndLimited, sndbufLimited; // usec
+};
+
+class TcpInfoSampler {
+ public:
+    TcpInfoSampler();
+    ~TcpInfoSampler();
+    // start sampling sd every intervalMs on a new thread (no-op if intervalMs <= 0)
+    void start(int sd, int intervalMs);
+    void stop(); // take a last sample and join the thread
+    // print the time series and a summary
+    void print(const std::string &label) const;
+    static bool sample(int sd, TcpSample &out); // one getsockopt( TCP_INFO )
+ private:
+    static void *run(void *self);
+
+    int sd;
+    int intervalMs;
+    long long startNs;
+    std::atomic<bool> running; // read by the sampler thread
+    pthread_t thread;
+    pthread_mutex_t lock; // guards samples
+    std::vector<TcpSample> samples;
+};
+
+#endif
@@ -0,0 +1,501 @@
+/**
+ * Author: Tanvir Tatla
+ * Description: TCP, AF_UNIX and shared-memory transports, see Transport.h
+**/
+#include "Transport.h"
+#include <iostream> // cout
+#include <cstring> // memset, memcpy, strerror
+#include <cerrno> // errno
+#include <cstddef> // offsetof
+#include <atomic> // atomic
+#include <algorithm> // min
+#include <netdb.h> // addrinfo
+#include <unistd.h> // read, write, close, ftruncate
+#include <poll.h> // poll
+#include <sys/socket.h> // socket, bind, listen, accept, sendmsg
+#include <sys/un.h> // sockaddr_un
+#include <sys/mman.h> // mmap, memfd_create
+#include <sys/syscall.h> // SYS_futex
+#include <linux/futex.h> // FUTEX_WAIT, FUTEX_WAKE
+#include <time.h> // timespec
+
+using namespace std;
+
+// socket transports ------------------------------------------------------------
+
+// SocketConnection passes every call straight to the socket
+class SocketConnection : public Connection {
+ public:
+    explicit SocketConnection(int sd) : sd(sd) {}
+    ~SocketConnection() { close(sd); }
+    ssize_t write(const void *buf, size_t length) { return ::write(sd, buf, length); }
+    ssize_t writev(const struct iovec *iov, int count) { return ::writev(sd, iov, count); }
+    ssize_t read(void *buf, size_t length) { return ::read(sd, buf, length); }
+    int fd() const { return sd; }
+ private:
+    int sd;
+};
+
+// acceptSocket accepts on listenSd, -1 on error or EINTR
+static int acceptSocket(int listenSd) {
+    struct sockaddr_storage newSockAddr;
+    socklen_t newSockAddrSize = sizeof( newSockAddr );
+    return accept( listenSd, (struct sockaddr *)&newSockAddr, &newSockAddrSize );
+}
+
+class TcpTransport : public Transport {
+ public:
+    TcpTransport() : listenSd(-1) {}
+    ~TcpTransport() { if (listenSd != -1) close(listenSd); }
+    const char *name() const { return "tcp"; }
+    Connection *connect(const char *host, int port, const SocketOptions &opts);
+    bool listen(int port, int backlog);
+    Connection *accept() {
+        int sd = acceptSocket(listenSd);
+        return sd == -1 ? nullptr : new SocketConnection(sd);
+    }
+    int listenFd() const { return listenSd; }
+ private:
+    int listenSd;
+};
+
+// connect tries every address of host until one accepts the connection
+Connection *TcpTransport::connect(const char *host, int port, const SocketOptions &opts) {
+    struct addrinfo hints;
+    struct addrinfo *servInfo; // list of socket addresses from getaddrinfo
+    memset(&hints, 0, sizeof(hints) );
+    hints.ai_family = AF_UNSPEC; // Address Family Internet
+    hints.ai_socktype = SOCK_STREAM; // TCP
+    int status = getaddrinfo(host, to_string(port).c_str(), &hints, &servInfo );
+
+    // terminate if getaddrinfo failed
+    if (status != 0) {
+        cout << gai_strerror(status) << endl;
+        return nullptr;
+    }
+
+    struct addrinfo *p; // current address
+    int clientSd = -1;
+
+    // iterate over list of socket addresses
+    for (p = servInfo; p != nullptr; p = p->ai_next) {
+        // create socket
+        clientSd = socket( p->ai_family, p->ai_socktype, p->ai_protocol );
+
+        // try next address
+        if (clientSd == -1) continue;
+
+        applySenderOptions(clientSd, opts); // before connect for window scaling
+
+        // open connection on socket file descriptor (clientSd), try next
+        // address if connect failed
+        if (::connect( clientSd, p->ai_addr, p->ai_addrlen) == -1) {
+            close(clientSd);
+            clientSd = -1;
+            continue;
+        }
+
+        break; // stop if socket and connect succeeded
+    }
+
+    freeaddrinfo(servInfo);
+    return clientSd == -1 ? nullptr : new SocketConnection(clientSd);
+}
+
+// listen binds the first local address that works
+bool TcpTransport::listen(int port, int backlog) {
+    struct addrinfo hints, *res; // res is a list of addresses
+    memset( &hints, 0, sizeof (hints) );
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    int status = getaddrinfo(NULL, to_string(port).c_str(), &hints, &res);
+
+    if (status != 0) {
+        cout << gai_strerror(status) << endl;
+        return false;
+    }
+
+    struct addrinfo *p; // current address
+    int error = 0; // errno of the last failed attempt
+
+    // iterate over list of addresses.
+    for (p = res; p != nullptr; p = p->ai_next) {
+        // create TCP socket
+        listenSd = socket(p->ai_family, p->ai_socktype, p->ai_protocol);
+
+        if (listenSd == -1) {
+            error = errno;
+            continue;
+        }
+
+        // set socket option
+        const int yes = 1;
+        if (setsockopt( listenSd, SOL_SOCKET, SO_REUSEADDR, (char *)&yes,sizeof( yes ) ) == -1 ||
+            bind( listenSd, p->ai_addr, p->ai_addrlen ) == -1) {
+            error = errno;
+            close(listenSd);
+            listenSd = -1;
+            continue;
+        }
+
+        break; // success
+    }
+
+    freeaddrinfo(res);
+    if (!p) {
+        cout << "Unable to bind port " << port << ": " << strerror(error) << endl;
+        return false;
+    }
+
+    if (::listen(listenSd, backlog) == -1) { // prepare to accept connections
+        cout << "Unable to listen on port " << port << ": " << strerror(errno) << endl;
+        close(listenSd);
+        listenSd = -1;
+        return false;
+    }
+    return true;
+}
+
+// unixAddress fills addr with the abstract name "hw1-<kind>-<port>" and
+// returns its length. Abstract names need no file and vanish with the socket.
+static socklen_t unixAddress(struct sockaddr_un &addr, const string &kind, int port) {
+    string name = "hw1-" + kind + "-" + to_string(port);
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path + 1, name.data(), name.size()); // sun_path[0] = '\0'
+    return offsetof(struct sockaddr_un, sun_path) + 1 + name.size();
+}
+
+// unixConnect connects an AF_UNIX socket of the given type, -1 on failure
+static int unixConnect(int socketType, const string &kind, int port) {
+    struct sockaddr_un addr;
+    socklen_t length = unixAddress(addr, kind, port);
+    int sd = socket(AF_UNIX, socketType, 0);
+    if (sd == -1) return -1;
+    if (::connect(sd, (struct sockaddr *) &addr, length) == -1) {
+        close(sd);
+        return -1;
+    }
+    return sd;
+}
+
+// unixListen binds and listens on an AF_UNIX socket, -1 on failure
+static int unixListen(int socketType, const string &kind, int port, int backlog) {
+    struct sockaddr_un addr;
+    socklen_t length = unixAddress(addr, kind, port);
+    int sd = socket(AF_UNIX, socketType, 0);
+    if (sd == -1) return -1;
+    if (bind(sd, (struct sockaddr *) &addr, length) == -1 || ::listen(sd, backlog) == -1) {
+        cout << "Unable to listen on AF_UNIX " << kind << ": " << strerror(errno) << endl;
+        close(sd);
+        return -1;
+    }
+    return sd;
+}
+
+// UnixTransport is AF_UNIX with SOCK_STREAM or SOCK_SEQPACKET. A seqpacket
+// write is one record, and a receive buffer shorter than the record
+// truncates it. The read loops ask for the whole remaining message, and
+// readv( ) scatters one record over all the buffers, but a recvmmsg( ) entry
+// holds one record cut to a single buffer, so the server refuses recvmmsg
+// on seqpacket.
+class UnixTransport : public Transport {
+ public:
+    UnixTransport(int socketType, const char *kind)
+        : socketType(socketType), kind(kind), listenSd(-1) {}
+    ~UnixTransport() { if (listenSd != -1) close(listenSd); }
+    const char *name() const { return kind; }
+
+    // only the buffer size and busy polling apply to AF_UNIX
+    Connection *connect(const char *, int port, const SocketOptions &opts) {
+        int sd = unixConnect(socketType, kind, port);
+        if (sd == -1) return nullptr;
+        SocketOptions unixOpts;
+        unixOpts.sndbuf = opts.sndbuf;
+        unixOpts.busyPoll = opts.busyPoll;
+        applySenderOptions(sd, unixOpts);
+        return new SocketConnection(sd);
+    }
+    bool listen(int port, int backlog) {
+        listenSd = unixListen(socketType, kind, port, backlog);
+        return listenSd != -1;
+    }
+    Connection *accept() {
+        int sd = acceptSocket(listenSd);
+        return sd == -1 ? nullptr : new SocketConnection(sd);
+    }
+    int listenFd() const { return listenSd; }
+ private:
+    int socketType;
+    const char *kind;
+    int listenSd;
+};
+
+// shared-memory ring -------------------------------------------------------------
+//
+// The client creates a memfd holding two single-producer/single-consumer
+// rings, one per direction, and hands the descriptor to the server over an
+// AF_UNIX control socket (SCM_RIGHTS). Data never passes through the kernel:
+// a writer copies into the ring and publishes the new head, the reader
+// copies out and publishes the new tail. A side that finds the ring full or
+// empty spins for a while, then sleeps on a futex on the counter it waits
+// for; the other side only makes the wake-up system call when a waiter has
+// announced itself. The control socket stays open so either side notices
+// when the other process exits.
+
+const uint32_t RING_SIZE = SHM_RING_SIZE; // bytes per direction, a power of two
+const int SPIN_LIMIT = 1000; // checks before sleeping on the futex
+const long FUTEX_TIMEOUT_NS = 100 * 1000000L; // recheck the peer this often
+
+// Ring is one direction. head and tail count bytes modulo 2^32, so
+// head - tail is the fill level; they sit on their own cache lines so the
+// writer and reader do not false-share.
+struct Ring {
+    alignas(64) atomic<uint32_t> head; // bytes written
+    atomic<uint32_t> readerWaiting; // reader is (about to be) asleep on head
+    alignas(64) atomic<uint32_t> tail; // bytes read
+    atomic<uint32_t> writerWaiting; // writer is (about to be) asleep on tail
+    alignas(64) atomic<uint32_t> closed; // one side closed the connection
+    alignas(64) char data[RING_SIZE];
+};
+
+// the mapping starts zeroed, which is a valid initial state for both rings
+struct ShmRegion {
+    Ring toServer, toClient;
+};
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2, "the rings need lock-free atomics across processes");
+
+static long futex(atomic<uint32_t> &word, int op, uint32_t value, const struct timespec *timeout) {
+    return syscall(SYS_futex, (uint32_t *) &word, op, value, timeout, nullptr, 0);
+}
+
+static inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+class ShmConnection : public Connection {
+ public:
+    ShmConnection(int control, ShmRegion *region, bool server)
+        : control(control), region(region),
+          out(server ? &region->toClient : &region->toServer),
+          in(server ? &region->toServer : &region->toClient) {}
+    ~ShmConnection();
+    ssize_t write(const void *buf, size_t length);
+    ssize_t writev(const struct iovec *iov, int count);
+    ssize_t read(void *buf, size_t length);
+    int fd() const { return -1; }
+ private:
+    bool wait(atomic<uint32_t> &word, uint32_t seen, atomic<uint32_t> &waiting);
+    void wake(atomic<uint32_t> &word, atomic<uint32_t> &waiting);
+
+    int control; // AF_UNIX control socket, detects a peer that exited
+    ShmRegion *region;
+    Ring *out, *in; // rings this side writes and reads
+};
+
+ShmConnection::~ShmConnection() {
+    for (Ring *r : { out, in }) {
+        r->closed.store(1);
+        futex(r->head, FUTEX_WAKE, INT32_MAX, nullptr);
+        futex(r->tail, FUTEX_WAKE, INT32_MAX, nullptr);
+    }
+    munmap(region, sizeof(ShmRegion));
+    close(control);
+}
+
+// wait returns once word no longer holds seen (the caller rechecks), or
+// false if the connection was closed or the peer went away meanwhile
+bool ShmConnection::wait(atomic<uint32_t> &word, uint32_t seen, atomic<uint32_t> &waiting) {
+    for (int i = 0; i < SPIN_LIMIT; i++) {
+        if (word.load(memory_order_acquire) != seen) return true;
+        cpuRelax();
+    }
+
+    // announce ourselves, then check once more so a wake-up between the last
+    // check and the futex call is not lost (the futex also compares)
+    waiting.store(1);
+    while (word.load() == seen) {
+        if (in->closed.load() || out->closed.load()) {
+            waiting.store(0);
+            return false;
+        }
+        struct timespec timeout = { 0, FUTEX_TIMEOUT_NS };
+        if (futex(word, FUTEX_WAIT, seen, &timeout) == -1 && errno == ETIMEDOUT) {
+            struct pollfd pfd = { control, POLLRDHUP, 0 };
+            if (poll(&pfd, 1, 0) > 0) { // peer process closed or exited
+                waiting.store(0);
+                return false;
+            }
+        }
+    }
+    waiting.store(0);
+    return true;
+}
+
+// wake makes the futex call only if the other side announced it is waiting
+void ShmConnection::wake(atomic<uint32_t> &word, atomic<uint32_t> &waiting) {
+    if (waiting.load()) futex(word, FUTEX_WAKE, 1, nullptr);
+}
+
+ssize_t ShmConnection::write(const void *buf, size_t length) {
+    const char *p = (const char *) buf;
+    uint32_t head = out->head.load(memory_order_relaxed);
+    size_t written = 0;
+    while (written < length) {
+        uint32_t space = RING_SIZE - (head - out->tail.load(memory_order_acquire));
+        if (space == 0) {
+            if (!wait(out->tail, head - RING_SIZE, out->writerWaiting)) return written ? written : -1;
+            continue;
+        }
+
+        // copy up to the end of the buffer, then wrap to the start
+        uint32_t n = (uint32_t) min((size_t) space, length - written);
+        uint32_t offset = head & (RING_SIZE - 1);
+        uint32_t first = min(n, RING_SIZE - offset);
+        memcpy(out->data + offset, p + written, first);
+        memcpy(out->data, p + written + first, n - first);
+
+        head += n;
+        written += n;
+        out->head.store(head); // seq_cst: ordered before the readerWaiting check
+        wake(out->head, out->readerWaiting);
+    }
+    return written;
+}
+
+ssize_t ShmConnection::writev(const struct iovec *iov, int count) {
+    ssize_t total = 0;
+    for (int i = 0; i < count; i++) {
+        ssize_t n = write(iov[i].iov_base, iov[i].iov_len);
+        if (n < (ssize_t) iov[i].iov_len) return n < 0 && total == 0 ? -1 : total + max(n, (ssize_t) 0);
+        total += n;
+    }
+    return total;
+}
+
+ssize_t ShmConnection::read(void *buf, size_t length) {
+    uint32_t tail = in->tail.load(memory_order_relaxed);
+    uint32_t available;
+    while ((available = in->head.load(memory_order_acquire) - tail) == 0) {
+        if (!wait(in->head, tail, in->readerWaiting)) return 0; // closed: end of stream
+    }
+
+    uint32_t n = (uint32_t) min((size_t) available, length);
+    uint32_t offset = tail & (RING_SIZE - 1);
+    uint32_t first = min(n, RING_SIZE - offset);
+    memcpy(buf, in->data + offset, first);
+    memcpy((char *) buf + first, in->data, n - first);
+
+    in->tail.store(tail + n); // seq_cst: ordered before the writerWaiting check
+    wake(in->tail, in->writerWaiting);
+    return n;
+}
+
+// mapRegion maps the shared region from a memfd
+static ShmRegion *mapRegion(int memFd) {
+    void *p = mmap(nullptr, sizeof(ShmRegion), PROT_READ | PROT_WRITE, MAP_SHARED, memFd, 0);
+    return p == MAP_FAILED ? nullptr : (ShmRegion *) p;
+}
+
+class ShmTransport : public Transport {
+ public:
+    ShmTransport() : listenSd(-1) {}
+    ~ShmTransport() { if (listenSd != -1) close(listenSd); }
+    const char *name() const { return "shm"; }
+    Connection *connect(const char *host, int port, const SocketOptions &opts);
+    bool listen(int port, int backlog) {
+        listenSd = unixListen(SOCK_STREAM, "shm", port, backlog);
+        return listenSd != -1;
+    }
+    Connection *accept();
+    int listenFd() const { return listenSd; } // control connections only
+ private:
+    int listenSd;
+};
+
+// connect creates the region and passes it to the server. host must be
+// this machine and socket options do not apply.
+Connection *ShmTransport::connect(const char *, int port, const SocketOptions &) {
+    int control = unixConnect(SOCK_STREAM, "shm", port);
+    if (control == -1) return nullptr;
+
+    int memFd = memfd_create("hw1-ring", 0);
+    ShmRegion *region = nullptr;
+    if (memFd != -1 && ftruncate(memFd, sizeof(ShmRegion)) == 0) region = mapRegion(memFd);
+    if (!region) {
+        cout << "Unable to create the shared-memory ring: " << strerror(errno) << endl;
+        if (memFd != -1) close(memFd);
+        close(control);
+        return nullptr;
+    }
+
+    // one byte of data carries the descriptor
+    char byte = 0;
+    struct iovec iov = { &byte, 1 };
+    char space[CMSG_SPACE(sizeof(int))];
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    memset(space, 0, sizeof(space));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = space;
+    msg.msg_controllen = sizeof(space);
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &memFd, sizeof(int));
+
+    bool sent = sendmsg(control, &msg, 0) == 1;
+    close(memFd); // the mapping keeps the memory
+    if (!sent) {
+        munmap(region, sizeof(ShmRegion));
+        close(control);
+        return nullptr;
+    }
+    return new ShmConnection(control, region, false);
+}
+
+// accept takes the next control connection and maps the client's region
+Connection *ShmTransport::accept() {
+    int control = acceptSocket(listenSd);
+    if (control == -1) return nullptr;
+
+    char byte;
+    struct iovec iov = { &byte, 1 };
+    char space[CMSG_SPACE(sizeof(int))];
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = space;
+    msg.msg_controllen = sizeof(space);
+
+    ShmRegion *region = nullptr;
+    if (recvmsg(control, &msg, 0) == 1) {
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        if (cmsg && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+            int memFd;
+            memcpy(&memFd, CMSG_DATA(cmsg), sizeof(int));
+            region = mapRegion(memFd);
+            close(memFd);
+        }
+    }
+    if (!region) {
+        close(control);
+        return nullptr;
+    }
+    return new ShmConnection(control, region, true);
+}
+
+Transport *makeTransport(const string &name) {
+    if (name == "tcp") return new TcpTransport();
+    if (name == "unix") return new UnixTransport(SOCK_STREAM, "unix");
+    if (name == "seqpacket") return new UnixTransport(SOCK_SEQPACKET, "seqpacket");
+    if (name == "shm") return new ShmTransport();
+    return nullptr;
+}
@@ -0,0 +1,61 @@
+/**
+ * Author: Tanvir Tatla
+ * Description: Transports for the HW1 client and server. A Transport sets up
+ *              connections (connect on the client, listen/accept on the
+ *              server) and every Connection offers the same write, writev and
+ *              read calls, so the write tests run unchanged over TCP, AF_UNIX
+ *              stream and seqpacket sockets, or a shared-memory ring.
+ *              The AF_UNIX transports use the abstract socket namespace and
+ *              derive their address from the port, so the command lines stay
+ *              the same; the shared-memory ring only works between processes
+ *              on one host.
+**/
+#ifndef _TRANSPORT_H_
+#define _TRANSPORT_H_
+
+#include "SocketOptions.h" // SocketOptions
+#include <string> // string
+#include <sys/types.h> // ssize_t
+#include <sys/uio.h> // iovec
+
+// Connection is one open connection. The calls behave like their blocking
+// socket counterparts: write and writev send everything unless the peer is
+// gone, read returns what is available (at least one byte), 0 once the peer
+// has closed, -1 on error.
+class Connection {
+ public:
+    virtual ~Connection() {}
+    virtual ssize_t write(const void *buf, size_t length) = 0;
+    virtual ssize_t writev(const struct iovec *iov, int count) = 0;
+    virtual ssize_t read(void *buf, size_t length) = 0;
+    // socket descriptor for socket options and the socket-only write types
+    // and receive strategies, -1 if the connection is not a socket
+    virtual int fd() const = 0;
+};
+
+class Transport {
+ public:
+    virtual ~Transport() {}
+    virtual const char *name() const = 0;
+
+    // client: connect to host:port. Sender options are applied before the
+    // connect where the transport has them. Returns nullptr on failure.
+    virtual Connection *connect(const char *host, int port, const SocketOptions &opts) = 0;
+    // server: start listening on port with the given backlog
+    virtual bool listen(int port, int backlog) = 0;
+    // server: wait for the next connection. Returns nullptr on error or when
+    // interrupted by a signal (or, on a non-blocking listener, when no
+    // connection is pending).
+    virtual Connection *accept() = 0;
+    // server: the listening socket, for event loops
+    virtual int listenFd() const = 0;
+};
+
+// bytes the shm transport buffers in each direction
+const unsigned SHM_RING_SIZE = 1 << 20;
+
+// makeTransport returns a new transport by name: tcp, unix, seqpacket or
+// shm. Returns nullptr if the name is unknown.
+Transport *makeTransport(const std::string &name);
+
+#endif
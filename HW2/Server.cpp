@@ -19,12 +19,15 @@
 #include <netinet/tcp.h> // SO_REUSEADDR
 #include <sys/uio.h> // writev
 #include <sys/time.h> // timeval and timersub
+#include <csignal> // sigaction, pthread_sigmask
 
 using namespace std;
 
 const int BUFFSIZE = 1500;
 const int NUM_CONNECTIONS = 10;
 
+volatile sig_atomic_t stopping = 0; // set by SIGINT/SIGTERM to leave the accept loop
+
 // HTTP Response Codes
 const string BAD_REQUEST = "400 Bad Request\r\n\r\n";
 const string FORBIDDEN = "403 Forbidden\r\n\r\n";
@@ -84,12 +87,12 @@ string prepareResponse(string filePath) {
 string parseRequest(int sd) {
     string request;
     string filePath;
-    char curr;
 
     char buffer[BUFFSIZE];
-    while (recv(sd, &buffer, BUFFSIZE, 0) > 0)
+    int received;
+    while ((received = recv(sd, &buffer, BUFFSIZE, 0)) > 0)
     {
-        request += buffer;
+        request.append(buffer, received); // buffer is not null-terminated
         int end = request.find_last_of("\r\n\r\n") + 1;
         if (end > 0) {
             request.erase(end, request.size() - end);
@@ -112,7 +115,7 @@ string parseRequest(int sd) {
         if (filePath.find("./") == -1) { // filePath should be formatted /file (not just /)
             return BAD_REQUEST;
         }
-    } catch(out_of_range e) {
+    } catch(const out_of_range &) {
         return BAD_REQUEST;
     }
 
@@ -145,6 +148,7 @@ void *handleRequest(void *data) {
     send(sd, r, strlen(r), 0); // send response
     cout << "Closing connection" << endl << endl;
     close(sd); // close connection
+    return nullptr;
 }
 
 // createSocket opens a TCP socket for listening to clients
@@ -197,6 +201,23 @@ int createSocket() {
     return serverSd;
 }
 
+#ifndef NO_MAIN // benchmarks link this file without its main
+// stopServer is the SIGINT/SIGTERM handler. It only sets a flag so that
+// main returns normally (flushing output and any profile data).
+void stopServer(int) {
+    stopping = 1;
+}
+
+// installSignals makes SIGINT and SIGTERM interrupt accept( ) instead of
+// killing the process
+void installSignals() {
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = stopServer; // no SA_RESTART so accept( ) returns EINTR
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+}
+
 // main creates a TCP socket that listens on the port given as an argument. 
 // The server will accept an incoming connection and then create a new
 // thread that will handle the connection. The new thread will read all the 
@@ -219,21 +240,33 @@ int main(int numArgs, char *args[]) {
         return -1;
     }
 
-    // run indefinitely to accept incoming connections
-    while (true) {
+    installSignals();
+
+    // client threads start with SIGINT and SIGTERM blocked, so the signals
+    // always reach this thread and interrupt accept( )
+    sigset_t stopSignals, previous;
+    sigemptyset(&stopSignals);
+    sigaddset(&stopSignals, SIGINT);
+    sigaddset(&stopSignals, SIGTERM);
+
+    // run until interrupted to accept incoming connections
+    while (!stopping) {
         struct sockaddr_storage newSockAddr;
         socklen_t newSockAddrSize = sizeof( newSockAddr );
         // await connection request, open new socket upon connection
         int newSd = accept( serverSd, (struct sockaddr *)&newSockAddr, &newSockAddrSize );
 
         if (newSd == -1) {
+            if (stopping) break;
             cout << "Unable to accept client connection request." << endl;
             continue;
         }
 
         cout << "Accepted a client." << endl;
         pthread_t thread; // thread to handle new client
+        pthread_sigmask(SIG_BLOCK, &stopSignals, &previous);
         int result = pthread_create(&thread, nullptr, handleRequest, (void*) &newSd);
+        pthread_sigmask(SIG_SETMASK, &previous, nullptr);
 
         if (result != 0) {
             cout << "Unable to create thread." << endl;
@@ -242,4 +275,5 @@ int main(int numArgs, char *args[]) {
     }
 
     return 0;
-}
\ No newline at end of file
+}
+#endif
@@ -1,5 +1,11 @@
 #!/bin/bash
 # if error, run dos2unix build.sh
-g++ -std=c++11 -o server Server.cpp -lpthread
-cd retriever_testing
-g++ -std=c++11 -o retriever Retriever.cpp
\ No newline at end of file
+# Builds through the top-level Makefile (optimized release build) and copies
+# the binaries next to the demo scripts. Pass a config to use another build,
+# e.g. ./build.sh pgo
+set -e
+CONFIG=${1:-release}
+cd "$(dirname "$0")"
+make -C .. "$CONFIG"
+cp ../build/"$CONFIG"/HW2/server server
+cp ../build/"$CONFIG"/HW2/retriever retriever_testing/retriever
@@ -190,6 +190,7 @@ int openConnection() {
     return clientSd;
 }
 
+#ifndef NO_MAIN // benchmarks link this file without its main
 // main takes arguments from commandline and attempts to connect to server
 // Once connected, client sends data to server and waits for response.
 // Upon receiving response, it outputs response and then terminates.
@@ -226,4 +227,5 @@ int main (int numArgs, char *args[]) {
     close(clientSd); // close connection
     cout << endl;
     return 0;
-}
\ No newline at end of file
+}
+#endif
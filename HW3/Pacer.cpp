@@ -0,0 +1,60 @@
+// Tanvir Tatla
+// CSS 432
+
+#include "Pacer.h"
+#include "Timer.h"
+#include <algorithm>
+
+// Constructor ----------------------------------------------------------------
+// the bucket starts full, so the first burst packets go at once
+Pacer::Pacer( double rate, int burst, double gain ) :
+  perSecond( rate ), fixed( rate > 0 ), gain( gain ), tokens( burst ),
+  burst( max( burst, 1 ) ), last( Timer::now( ) ) {
+}
+
+// Add the tokens accrued since the last refill -------------------------------
+void Pacer::refill( ) {
+  long long now = Timer::now( );
+  tokens = min( tokens + ( now - last ) * perSecond / 1e9, ( double )burst );
+  last = now;
+}
+
+// Fix the rate ---------------------------------------------------------------
+void Pacer::setRate( double rate ) {
+  refill( );                 // tokens so far accrue at the old rate
+  perSecond = rate;
+  fixed = true;
+}
+
+// Follow gain * window / SRTT ------------------------------------------------
+// without an SRTT yet the rate stays as it was
+void Pacer::follow( int window, long srtt ) {
+  if ( fixed || gain <= 0 || srtt <= 0 )
+    return;
+  refill( );
+  perSecond = gain * window * 1e6 / srtt;
+}
+
+// Packets that may go now, up to wanted --------------------------------------
+int Pacer::available( int wanted ) {
+  if ( !paced( ) )
+    return wanted;
+  refill( );
+  return min( wanted, ( int )tokens );
+}
+
+// Take a token per packet sent -----------------------------------------------
+void Pacer::take( int count ) {
+  if ( paced( ) )
+    tokens -= count;
+}
+
+// Usec until a whole token is there, rounded up ------------------------------
+long Pacer::wait( ) {
+  if ( !paced( ) )
+    return 0;
+  refill( );
+  if ( tokens >= 1 )
+    return 0;
+  return ( long )( ( 1 - tokens ) * 1e6 / perSecond ) + 1;
+}
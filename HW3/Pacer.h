@@ -0,0 +1,40 @@
+// Tanvir Tatla
+// CSS 432
+
+#ifndef _PACER_H_
+#define _PACER_H_
+
+#define PACING_GAIN 1.25     // a followed rate is gain * window / SRTT
+
+// Pacer spreads sends out at a target rate with a token bucket: tokens
+// accrue at rate packets per second on Timer::now( ) (monotonic), up to
+// burst of them, and every packet sent takes one. The rate is either fixed
+// or follows the window, gain * window / SRTT, so that a window leaves over
+// a little less than a round trip instead of back to back:
+//   Pacer( )                          unpaced
+//   Pacer( rate, burst )              a fixed rate
+//   Pacer( 0, burst, PACING_GAIN )    following the window
+// Waits shorter than the poll( ) wakeup latency (tens of usec) overshoot, so
+// at high rates a burst of a few packets keeps the rate up.
+class Pacer {
+ public:
+  Pacer( double rate = 0, int burst = 1, double gain = 0 );
+  void setRate( double rate );          // packets per second, fixed from now on
+  void follow( int window, long srtt ); // rate from the window and SRTT in usec,
+                                        // unless the rate is fixed
+  int available( int wanted );          // packets that may go now, up to wanted
+  void take( int count );               // count packets went out
+  long wait( );                         // usec until the next packet may go
+  double rate( ) const { return perSecond; }
+  bool paced( ) const { return perSecond > 0; }
+ private:
+  double perSecond;          // current rate, 0 = unpaced
+  bool fixed;                // set explicitly, follow( ) leaves it alone
+  double gain;               // 0: the rate does not follow the window
+  double tokens;             // packets that may go now
+  int burst;                 // most tokens saved up while idle
+  long long last;            // Timer::now( ) at the last refill
+  void refill( );
+};
+
+#endif
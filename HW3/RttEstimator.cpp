@@ -0,0 +1,78 @@
+// Tanvir Tatla
+// CSS 432
+
+#include "RttEstimator.h"
+#include <algorithm>
+#include <cstdlib>
+
+// Constructor ----------------------------------------------------------------
+RttEstimator::RttEstimator( long initialRto, long minRto, long maxRto ) :
+  smoothed( 0 ), variation( 0 ), timeout( initialRto ), initial( initialRto ),
+  minRto( minRto ), maxRto( maxRto ), timeouts( 0 ) {
+  clamp( );
+}
+
+// Keep the RTO within [minRto, maxRto] ---------------------------------------
+void RttEstimator::clamp( ) {
+  timeout = min( max( timeout, minRto ), maxRto );
+}
+
+// Fold a measured RTT into SRTT/RTTVAR and recompute the RTO -----------------
+// a valid sample also ends any backoff
+void RttEstimator::sample( long rtt ) {
+  if ( series.empty( ) ) {
+    smoothed = rtt;
+    variation = rtt / 2;
+  } else {
+    variation = ( 3 * variation + labs( smoothed - rtt ) ) / 4;
+    smoothed = ( 7 * smoothed + rtt ) / 8;
+  }
+  timeout = smoothed + max( 1L, 4 * variation );
+  clamp( );
+
+  Sample s = { rtt, smoothed, variation, timeout };
+  series.push_back( s );
+}
+
+// Exponential backoff after a timeout ----------------------------------------
+void RttEstimator::backoff( ) {
+  timeout *= 2;
+  clamp( );
+  timeouts++;
+}
+
+// Forward progress without a sample: back to the unbacked-off RTO -----------
+void RttEstimator::progress( ) {
+  timeout = series.empty( ) ? initial : smoothed + max( 1L, 4 * variation );
+  clamp( );
+}
+
+// Print the RTT/RTO series ---------------------------------------------------
+void RttEstimator::report( ostream &out, int rows ) const {
+  out << "rtt samples = " << series.size( ) << " backoffs = " << timeouts
+      << " srtt = " << smoothed << " rttvar = " << variation
+      << " rto = " << timeout << endl;
+  if ( series.empty( ) )
+    return;
+
+  long lo = series[0].rtt, hi = series[0].rtt;
+  double sum = 0;
+  for ( const Sample &s : series ) {
+    lo = min( lo, s.rtt );
+    hi = max( hi, s.rtt );
+    sum += s.rtt;
+  }
+  out << "rtt min/avg/max = " << lo << "/" << ( long )( sum / series.size( ) )
+      << "/" << hi << endl;
+
+  // evenly spaced samples, always including the last one
+  int n = series.size( );
+  int step = max( 1, ( n + rows - 1 ) / rows );
+  out << "sample rtt srtt rttvar rto" << endl;
+  for ( int i = 0; i < n; i += step ) {
+    int j = ( i + step >= n ) ? n - 1 : i;
+    const Sample &s = series[j];
+    out << "  " << j << " " << s.rtt << " " << s.srtt << " " << s.rttvar
+        << " " << s.rto << endl;
+  }
+}
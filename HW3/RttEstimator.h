@@ -0,0 +1,56 @@
+// Tanvir Tatla
+// CSS 432
+
+#ifndef _RTTESTIMATOR_H_
+#define _RTTESTIMATOR_H_
+
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+#define RTO_INITIAL 1500     // usec, the old fixed TIMEOUT, until a sample arrives
+#define RTO_MIN 200          // usec
+#define RTO_MAX 2000000      // usec
+
+// RttEstimator computes the retransmission timeout from measured round-trip
+// times (Jacobson/Karels, as in RFC 6298, in usec):
+//   first sample R:  SRTT = R, RTTVAR = R/2
+//   later samples:   RTTVAR = 3/4 RTTVAR + 1/4 |SRTT - R|, SRTT = 7/8 SRTT + 1/8 R
+//   RTO = SRTT + max(1, 4 RTTVAR), clamped to [RTO_MIN, RTO_MAX]
+// Callers follow Karn's rule: they only sample packets that were never
+// retransmitted, and call backoff( ) on every timeout, which doubles the RTO
+// until the next valid sample. Senders whose acks can move the window past
+// retransmitted packets only call progress( ) on such acks to end the
+// backoff, so a run of losses cannot leave them at RTO_MAX. Every sample is
+// kept for reporting.
+class RttEstimator {
+ public:
+  RttEstimator( long initialRto = RTO_INITIAL, long minRto = RTO_MIN,
+                long maxRto = RTO_MAX );
+  void sample( long rtt );   // a measured RTT in usec
+  void backoff( );           // a timeout: double the RTO
+  void progress( );          // new data acked without a sample: end the backoff
+  long rto( ) const { return timeout; }
+  long srtt( ) const { return smoothed; }
+  long rttvar( ) const { return variation; }
+  int samples( ) const { return series.size( ); }
+  int backoffs( ) const { return timeouts; }
+  // summary of the series and up to rows samples spread over it
+  void report( ostream &out, int rows = 10 ) const;
+
+  struct Sample {
+    long rtt, srtt, rttvar, rto;   // usec, after the sample was taken
+  };
+  const vector<Sample> &history( ) const { return series; }
+ private:
+  long smoothed;             // SRTT
+  long variation;            // RTTVAR
+  long timeout;              // current RTO
+  long initial, minRto, maxRto;
+  int timeouts;              // backoff( ) calls
+  vector<Sample> series;
+  void clamp( );
+};
+
+#endif
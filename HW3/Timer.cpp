@@ -4,44 +4,126 @@
 // Date:         March 5, 2004
 
 #include "Timer.h"
+#include <fstream>
+#include <string>
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+#include <x86intrin.h>     // for __rdtsc( )
+#define HAVE_TSC 1
+#endif
+
+bool Timer::tsc = false;
+double Timer::nsecPerTick = 0;
+unsigned long long Timer::tscBase = 0;
+long long Timer::nsecBase = 0;
+
+#define CALIBRATION_NSEC 10000000LL // 10 msec against CLOCK_MONOTONIC
+
+// CLOCK_MONOTONIC in nsec ----------------------------------------------------
+static long long monotonic( ) {
+  struct timespec ts;
+  clock_gettime( CLOCK_MONOTONIC, &ts );
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
 
 // Constructor ----------------------------------------------------------------
-Timer::Timer( ) {
-  startTime.tv_sec = 0;
-  startTime.tv_usec = 0;
-  endTime.tv_sec = 0;
-  endTime.tv_usec = 0;
+Timer::Timer( ) : startTime( 0 ), endTime( 0 ), deadline( 0 ) {
+}
+
+// Current monotonic time in nsec ---------------------------------------------
+long long Timer::now( ) {
+#ifdef HAVE_TSC
+  if ( tsc )
+    return nsecBase + ( long long )( ( __rdtsc( ) - tscBase ) * nsecPerTick );
+#endif
+  return monotonic( );
+}
+
+// Switch all timers to the TSC (or back to CLOCK_MONOTONIC) ------------------
+// The TSC is only used when the CPU says it ticks at a constant rate and
+// keeps ticking in deep sleep states (constant_tsc and nonstop_tsc);
+// otherwise it is not a clock. It is calibrated once, on first use.
+bool Timer::useTsc( bool on ) {
+  if ( !on ) {
+    tsc = false;
+    return true;
+  }
+#ifdef HAVE_TSC
+  if ( nsecPerTick == 0 ) {
+    ifstream cpuinfo( "/proc/cpuinfo" );
+    string line;
+    bool constant = false, nonstop = false;
+    while ( getline( cpuinfo, line ) && line.compare( 0, 5, "flags" ) != 0 )
+      ;
+    constant = line.find( " constant_tsc" ) != string::npos;
+    nonstop = line.find( " nonstop_tsc" ) != string::npos;
+    if ( !constant || !nonstop )
+      return false;
+
+    long long nsec0 = monotonic( );
+    unsigned long long tick0 = __rdtsc( );
+    long long nsec1;
+    while ( ( nsec1 = monotonic( ) ) - nsec0 < CALIBRATION_NSEC )
+      ;
+    unsigned long long tick1 = __rdtsc( );
+    if ( tick1 <= tick0 )
+      return false;
+    nsecPerTick = ( double )( nsec1 - nsec0 ) / ( tick1 - tick0 );
+    tscBase = tick1;
+    nsecBase = nsec1;
+  }
+  tsc = true;
+  return true;
+#else
+  return false;
+#endif
 }
 
 // Memorize the current time in startTime -------------------------------------
 void Timer::start( ) {
-  gettimeofday( &startTime, NULL );
+  startTime = now( );
 }
 
 // Get the diff between the start and the curren time -------------------------
 long Timer::lap( ) {
-  gettimeofday( &endTime, NULL );
-  long interval =
-    ( endTime.tv_sec - startTime.tv_sec ) * 1000000 +
-    ( endTime.tv_usec - startTime.tv_usec );
-  return interval;
+  return lapNsec( ) / 1000;
 }
 
 // Get the diff between the old and the current time --------------------------
 long Timer::lap( long oldTv_sec, long oldTv_usec ) {
-  gettimeofday( &endTime, NULL );
-  long interval =
-    ( endTime.tv_sec - oldTv_sec ) * 1000000 +
-    ( endTime.tv_usec - oldTv_usec );
-  return interval;
+  endTime = now( );
+  return ( endTime - ( oldTv_sec * 1000000000LL + oldTv_usec * 1000LL ) ) / 1000;
+}
+
+// Get the diff between the start and the current time in nsec ----------------
+long long Timer::lapNsec( ) {
+  endTime = now( );
+  return endTime - startTime;
 }
 
 // Get sec --------------------------------------------------------------------
 long Timer::getSec( ) {
-  return startTime.tv_sec;
+  return startTime / 1000000000LL;
 }
 
 // Get usec -------------------------------------------------------------------
 long Timer::getUsec( ) {
-  return startTime.tv_usec;
+  return ( startTime % 1000000000LL ) / 1000;
+}
+
+// Start the timer with a deadline usec from now ------------------------------
+void Timer::setTimeout( long usec ) {
+  start( );
+  deadline = startTime + usec * 1000LL;
+}
+
+// Check whether the deadline has passed --------------------------------------
+bool Timer::expired( ) {
+  return now( ) >= deadline;
+}
+
+// Get the usec left until the deadline (0 once it has passed) ----------------
+long Timer::remaining( ) {
+  long long left = deadline - now( );
+  return ( left > 0 ) ? ( left + 999 ) / 1000 : 0;
 }
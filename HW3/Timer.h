@@ -12,20 +12,39 @@ using namespace std;
 
 extern "C"
 {
-#include <sys/time.h>
+#include <time.h>          // for clock_gettime( )
 }
 
+// Times are taken from CLOCK_MONOTONIC, which never jumps when the wall
+// clock is set. useTsc( ) switches every Timer to the CPU's time-stamp
+// counter, calibrated against CLOCK_MONOTONIC, where it runs at a constant
+// rate; reading it costs a few nanoseconds instead of a vDSO call.
 class Timer {
  public:
   Timer( );                  // Constructor
   void start( );             // Memorize the curren time in startTime
-  long lap( );               // endTime - startTime
-  long lap( long oldTv_sec, long oldTv_usec ); // endTime - oldTime
-  long getSec( );            // get startTime.tv_sec
-  long getUsec( );           // get startTime.tv_usec
+  long lap( );               // endTime - startTime, in usec
+  long lap( long oldTv_sec, long oldTv_usec ); // endTime - oldTime, in usec
+  long long lapNsec( );      // endTime - startTime, in nsec
+  long getSec( );            // get startTime's sec
+  long getUsec( );           // get startTime's usec
+
+  // deadlines: start the timer and expire usec from now
+  void setTimeout( long usec );
+  bool expired( );           // has the deadline passed?
+  long remaining( );         // usec left until the deadline, 0 once expired
+
+  static long long now( );   // current monotonic time in nsec
+  static bool useTsc( bool ); // time with the TSC; false if not usable here
  private:
-  struct timeval startTime;  // Memorize the time to have started an evaluation
-  struct timeval endTime;    // Memorize the time to have stopped an evaluation
+  long long startTime;       // Memorize the time to have started an evaluation
+  long long endTime;         // Memorize the time to have stopped an evaluation
+  long long deadline;        // when setTimeout( ) expires
+
+  static bool tsc;           // now( ) reads the TSC
+  static double nsecPerTick; // TSC calibration
+  static unsigned long long tscBase; // TSC at calibration
+  static long long nsecBase;         // CLOCK_MONOTONIC at calibration
 };
 
 #endif
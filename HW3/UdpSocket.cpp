@@ -5,9 +5,15 @@
 // Updated by Yang Peng on 12/10/2019
 
 #include "UdpSocket.h"
+#include "Timer.h"    // for Timer::now( )
+#include <algorithm>  // for min( ), max( )
 
 // Constructor ----------------------------------------------------------------
-UdpSocket::UdpSocket( const char* port ) : port( port ), sd( NULL_SD ) {
+UdpSocket::UdpSocket( const char* port ) : port( port ), sd( NULL_SD ),
+                                           spinLimit( 0 ), spinBudget( 0 ),
+                                           offload( false ), truncated( 0 ),
+                                           heldStart( 0 ), heldEnd( 0 ),
+                                           heldSegSize( 0 ) {
 
 	struct addrinfo hints, *res, *p;
 	memset(&hints, 0, sizeof(hints));		// Zero-initialize hints
@@ -53,13 +59,19 @@ UdpSocket::~UdpSocket( ) {
 
 // Set the IP addr given a destination IP name ----------------------
 bool UdpSocket::setDestAddress( const char* ipName ) {
+	return setDestAddress( ipName, port );          // peer uses our port number
+}
+
+// Set the IP addr and port given a destination IP name and port ------------
+// lets two sockets on the same host talk to each other (e.g. loopback tests)
+bool UdpSocket::setDestAddress( const char* ipName, const char* destPort ) {
 
 	struct addrinfo hints, *res;
 	memset(&hints, 0, sizeof(hints) );
 	hints.ai_family = AF_UNSPEC; // use IPv4 or IPv6, whichever
 	hints.ai_socktype = SOCK_DGRAM;  // use UDP
 
-	if (getaddrinfo(ipName, port, &hints, &res) < 0) {
+	if (getaddrinfo(ipName, destPort, &hints, &res) < 0) {
 		cerr << "Cannot find hostname: " << ipName << endl;
 		return false;                                // set in failure
 	}
@@ -73,6 +85,9 @@ bool UdpSocket::setDestAddress( const char* ipName ) {
 
 // Check if this socket has data to receive -----------------------------------
 int UdpSocket::pollRecvFrom( ) {
+  if ( heldStart < heldEnd )
+    return 1;                 // segments held from a coalesced datagram
+
   struct pollfd pfd[1];
   pfd[0].fd = sd;             // declare I'll check the data availability of sd
   pfd[0].events = POLLRDNORM; // declare I'm interested in only reading from sd
@@ -82,6 +97,55 @@ int UdpSocket::pollRecvFrom( ) {
   return poll( pfd, 1, 0 );
 }
 
+// Current monotonic time in usec, on the same clock as Timer ----------------
+static long nowUsec( ) {
+  return Timer::now( ) / 1000;
+}
+
+// Let waitRecv( ) spin up to usec before it blocks (0 turns spinning off) ----
+void UdpSocket::setSpin( long usec ) {
+  spinLimit = spinBudget = ( usec > 0 ) ? usec : 0;
+}
+
+// Wait until data arrives or usec pass (usec < 0 waits forever) --------------
+// A short spin on pollRecvFrom( ) catches data that is about to arrive
+// without a sleep and wake-up; after it the thread blocks in ppoll( ), so an
+// idle endpoint costs no CPU. The spin adapts: it doubles (up to spinLimit)
+// when data came during the spin or shortly after it, and halves when the
+// spin was wasted. Returns a positive number if data is ready, 0 on timeout,
+// or a negative number on error.
+int UdpSocket::waitRecv( long usec ) {
+  if ( heldStart < heldEnd )
+    return 1;                 // segments held from a coalesced datagram
+  long start = nowUsec( );
+
+  if ( spinBudget > 0 ) {
+    long spinEnd = start + ( ( usec >= 0 && usec < spinBudget ) ? usec : spinBudget );
+    do {
+      if ( pollRecvFrom( ) > 0 ) {
+        spinBudget = min( spinLimit, spinBudget * 2 );
+        return 1;
+      }
+    } while ( nowUsec( ) < spinEnd );
+  }
+
+  long left = ( usec < 0 ) ? -1 : usec - ( nowUsec( ) - start );
+  if ( usec >= 0 && left <= 0 )
+    return 0;                                      // timed out while spinning
+
+  struct pollfd pfd[1];
+  pfd[0].fd = sd;
+  pfd[0].events = POLLRDNORM;
+  struct timespec timeout = { left / 1000000, ( left % 1000000 ) * 1000 };
+  int ready = ppoll( pfd, 1, ( usec < 0 ) ? NULL : &timeout, NULL );
+
+  if ( spinLimit > 0 ) {
+    bool soon = ready > 0 && nowUsec( ) - start <= 2 * spinLimit;
+    spinBudget = soon ? min( spinLimit, max( spinBudget * 2, 1L ) ) : spinBudget / 2;
+  }
+  return ready;
+}
+
 // Send msg[] of length size through the sd socket ----------------------------
 int UdpSocket::sendTo( char msg[], int length ) {
 
@@ -91,7 +155,27 @@ int UdpSocket::sendTo( char msg[], int length ) {
 }
 
 // Receive data through the sd socket and store it in msg[] of lenth size -----
+// with offload on, a coalesced datagram gives its first segment and the
+// rest is held for the next receive
 int UdpSocket::recvFrom( char msg[], int length ) {
+  if ( heldStart < heldEnd ) {  // a segment held from a coalesced datagram
+    char *msgs[1] = { msg };
+    recvHeld( msgs, &length, 1 );
+    return length;
+  }
+  if ( offload ) {
+    int segSize;
+    int n = recvSegments( msg, length, segSize );
+    if ( n > segSize && segSize > 0 ) {  // put back all but the first segment
+      if ( heldStart == heldEnd )
+        heldStart = heldEnd = UDP_MAX_GRO;
+      heldStart -= n - segSize;
+      memcpy( &held[heldStart], msg + segSize, n - segSize );
+      heldSegSize = segSize;
+      n = segSize;
+    }
+    return n;
+  }
   
   // zero-initialize the srcAddr structure so that it can be filled out with
   // the address of the source computer that has sent msg[]
@@ -111,3 +195,237 @@ int UdpSocket::ackTo( char msg[], int length ) {
   // return the number of bytes sent
   return sendto( sd, msg, length, 0, &srcAddr, sizeof( srcAddr ) );
 }
+
+// Point the reusable batch headers at msgs[] ---------------------------------
+void UdpSocket::prepareBatch( char* msgs[], int lengths[], int count ) {
+  if ( ( int )mmsgs.size( ) < count ) {
+    mmsgs.resize( count );
+    iovs.resize( count );
+    srcAddrs.resize( count );
+  }
+  memset( &mmsgs[0], 0, count * sizeof( struct mmsghdr ) );
+  for ( int i = 0; i < count; i++ ) {
+    iovs[i].iov_base = msgs[i];
+    iovs[i].iov_len = lengths[i];
+    mmsgs[i].msg_hdr.msg_iov = &iovs[i];
+    mmsgs[i].msg_hdr.msg_iovlen = 1;
+  }
+}
+
+// Send count messages, to addrs[i] or else to *addr, with sendmmsg( ) --------
+// returns the number of messages sent, or a negative number if none was
+int UdpSocket::sendBatchTo( char* msgs[], int lengths[], int count,
+                            struct sockaddr addrs[], struct sockaddr* addr ) {
+  prepareBatch( msgs, lengths, count );
+  for ( int i = 0; i < count; i++ ) {
+    mmsgs[i].msg_hdr.msg_name = ( addrs != NULL ) ? &addrs[i] : addr;
+    mmsgs[i].msg_hdr.msg_namelen = sizeof( struct sockaddr );
+  }
+
+  // sendmmsg( ) may stop early; resume after what went out
+  int sent = 0;
+  while ( sent < count ) {
+    int n = sendmmsg( sd, &mmsgs[sent], count - sent, 0 );
+    if ( n <= 0 )
+      return ( sent > 0 ) ? sent : n;
+    sent += n;
+  }
+  return sent;
+}
+
+// Send count messages to the destination in one system call ------------------
+int UdpSocket::sendBatch( char* msgs[], int lengths[], int count ) {
+  return sendBatchTo( msgs, lengths, count, NULL, &destAddr );
+}
+
+// Receive up to count queued messages in one system call ---------------------
+// (with offload on, recvSegments( ) takes coalesced datagrams whole)
+// does not wait (use waitRecv( ) first); fills lengths[] with each message's
+// size and addrs[], if given, with each sender. srcAddr becomes the last
+// sender so ackTo( ) answers it. returns the number of messages received,
+// or a negative number if none was queued.
+int UdpSocket::recvBatch( char* msgs[], int lengths[], int count,
+                          struct sockaddr addrs[] ) {
+  if ( heldStart < heldEnd ) {  // segments held from a coalesced datagram
+    int n = recvHeld( msgs, lengths, count );
+    for ( int i = 0; addrs != NULL && i < n; i++ )
+      addrs[i] = srcAddr;
+    return n;
+  }
+
+  prepareBatch( msgs, lengths, count );
+  for ( int i = 0; i < count; i++ ) {
+    mmsgs[i].msg_hdr.msg_name = &srcAddrs[i];
+    mmsgs[i].msg_hdr.msg_namelen = sizeof( struct sockaddr );
+  }
+
+  int n = recvmmsg( sd, &mmsgs[0], count, MSG_DONTWAIT, NULL );
+  for ( int i = 0; i < n; i++ ) {
+    lengths[i] = mmsgs[i].msg_len;
+    if ( addrs != NULL )
+      addrs[i] = srcAddrs[i];
+  }
+  if ( n > 0 )
+    srcAddr = srcAddrs[n - 1];
+  return n;
+}
+
+// Send count acks in one system call, to addrs[i] or the last source ---------
+int UdpSocket::ackBatch( char* msgs[], int lengths[], int count,
+                         struct sockaddr addrs[] ) {
+  return sendBatchTo( msgs, lengths, count, addrs, &srcAddr );
+}
+
+// Copy up to count held segments into msgs[], one each ----------------------
+// lengths[] holds the room in each message on the way in and the bytes
+// copied on the way out. returns the number of messages filled.
+int UdpSocket::recvHeld( char* msgs[], int lengths[], int count ) {
+  int n = 0;
+  for ( ; n < count && heldStart < heldEnd; n++ ) {
+    int size = min( heldSegSize, heldEnd - heldStart );
+    lengths[n] = min( lengths[n], size );
+    memcpy( msgs[n], &held[heldStart], lengths[n] );
+    heldStart += size;
+  }
+  return n;
+}
+
+// Turn segmentation offload on or off ----------------------------------------
+// UDP_SEGMENT needs nothing up front (each send carries its segment size in
+// a cmsg); UDP_GRO must be set on the receiving socket. Returns false and
+// leaves offload off if the kernel does not know UDP_GRO.
+bool UdpSocket::setSegmentation( bool on ) {
+  int value = on ? 1 : 0;
+  if ( setsockopt( sd, SOL_UDP, UDP_GRO, &value, sizeof( value ) ) < 0 ) {
+    offload = false;
+    return !on;
+  }
+  offload = on;
+  if ( on && held.empty( ) )
+    held.resize( 2 * UDP_MAX_GRO ); // a coalesced datagram spills into it
+  return true;
+}
+
+// Send length bytes of msg[] to *addr as segSize-byte datagrams --------------
+// one sendmsg( ) per super-packet of at most UDP_MAX_SEGMENTS segments and
+// UDP_MAX_PAYLOAD bytes. returns the bytes sent, or a negative number if
+// nothing was.
+int UdpSocket::sendSegmentsTo( char msg[], int length, int segSize,
+                               struct sockaddr* addr ) {
+  int perSend = min( UDP_MAX_SEGMENTS, UDP_MAX_PAYLOAD / segSize ) * segSize;
+  char control[CMSG_SPACE( sizeof( uint16_t ) )];
+  int sent = 0;
+
+  while ( sent < length ) {
+    struct iovec iov;
+    iov.iov_base = msg + sent;
+    iov.iov_len = min( perSend, length - sent );
+
+    struct msghdr hdr;
+    memset( &hdr, 0, sizeof( hdr ) );
+    hdr.msg_name = addr;
+    hdr.msg_namelen = sizeof( struct sockaddr );
+    hdr.msg_iov = &iov;
+    hdr.msg_iovlen = 1;
+
+    // a single segment goes out as a plain datagram
+    if ( ( int )iov.iov_len > segSize ) {
+      memset( control, 0, sizeof( control ) );
+      hdr.msg_control = control;
+      hdr.msg_controllen = sizeof( control );
+      struct cmsghdr *cm = CMSG_FIRSTHDR( &hdr );
+      cm->cmsg_level = SOL_UDP;
+      cm->cmsg_type = UDP_SEGMENT;
+      cm->cmsg_len = CMSG_LEN( sizeof( uint16_t ) );
+      uint16_t size = segSize;
+      memcpy( CMSG_DATA( cm ), &size, sizeof( size ) );
+    }
+
+    int n = sendmsg( sd, &hdr, 0 );
+    if ( n <= 0 )
+      return ( sent > 0 ) ? sent : n;
+    sent += n;
+  }
+  return sent;
+}
+
+// Send length bytes of msg[] to the destination as segSize-byte datagrams ----
+int UdpSocket::sendSegments( char msg[], int length, int segSize ) {
+  return sendSegmentsTo( msg, length, segSize, &destAddr );
+}
+
+// Send length bytes of acks in msg[] to the last source, segSize each --------
+int UdpSocket::ackSegments( char msg[], int length, int segSize ) {
+  return sendSegmentsTo( msg, length, segSize, &srcAddr );
+}
+
+// Receive one (possibly coalesced) datagram into msg[] of length size --------
+// segSize is set from the UDP_GRO cmsg, or to the datagram's own size if the
+// kernel delivered it as it was sent. A coalesced datagram may hold more
+// than length bytes: the kernel puts the rest in held (a second iovec, so
+// nothing is copied when it fits), and msg[] gets only whole segments. The
+// segments left over are held for the next receive, which pollRecvFrom( )
+// and waitRecv( ) report as ready. A datagram larger than msg[] and held
+// together comes back with MSG_TRUNC, which truncations( ) counts. Returns
+// the bytes received.
+int UdpSocket::recvSegments( char msg[], int length, int &segSize ) {
+  if ( heldStart < heldEnd ) {  // whole segments held from the last datagram
+    segSize = heldSegSize;
+    int n = min( heldEnd - heldStart, length - length % heldSegSize );
+    memcpy( msg, &held[heldStart], n );
+    heldStart += n;
+    return n;
+  }
+
+  char control[CMSG_SPACE( sizeof( int ) )];
+  struct iovec iov[2];
+  iov[0].iov_base = msg;
+  iov[0].iov_len = length;
+  iov[1].iov_base = held.empty( ) ? NULL : &held[UDP_MAX_GRO];
+  iov[1].iov_len = held.empty( ) ? 0 : UDP_MAX_GRO;
+
+  struct msghdr hdr;
+  memset( &hdr, 0, sizeof( hdr ) );
+  hdr.msg_name = &srcAddr;
+  hdr.msg_namelen = sizeof( srcAddr );
+  hdr.msg_iov = iov;
+  hdr.msg_iovlen = 2;
+  hdr.msg_control = control;
+  hdr.msg_controllen = sizeof( control );
+
+  int n = recvmsg( sd, &hdr, 0 );
+  segSize = n;
+  if ( n <= 0 )
+    return n;
+  bool cut = ( hdr.msg_flags & MSG_TRUNC ) != 0;
+  if ( cut )
+    truncated++;
+
+  for ( struct cmsghdr *cm = CMSG_FIRSTHDR( &hdr ); cm != NULL;
+        cm = CMSG_NXTHDR( &hdr, cm ) ) {
+    if ( cm->cmsg_level == SOL_UDP && cm->cmsg_type == UDP_GRO ) {
+      int size;
+      memcpy( &size, CMSG_DATA( cm ), sizeof( size ) );
+      if ( size > 0 )
+        segSize = size;
+    }
+  }
+  if ( n <= length )
+    return ( cut && segSize < n ) ? n - n % segSize : n;
+  if ( segSize >= n || segSize > length ) {
+    truncated++;                // not coalesced, or no whole segment fits
+    return length;
+  }
+
+  // keep what follows the last whole segment in msg[]: its tail in msg[]
+  // goes just before the spilled bytes, which are already in held
+  int whole = length - length % segSize;
+  int tail = length - whole;
+  memcpy( &held[UDP_MAX_GRO - tail], msg + whole, tail );
+  heldStart = UDP_MAX_GRO - tail;
+  heldEnd = UDP_MAX_GRO + ( n - length );
+  heldSegSize = segSize;
+  if ( cut )                    // drop the partial segment at the end
+    heldEnd -= ( heldEnd - heldStart ) % segSize;
+  return whole;
+}
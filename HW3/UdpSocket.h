@@ -8,6 +8,7 @@
 #define _UDPSOCKET_H_
 
 #include <iostream>
+#include <vector>
 #define MSGSIZE 1460      // UDP message size in bytes
 
 using namespace std;
@@ -24,8 +25,21 @@ extern "C"
 #include <string.h>       // for bzero( )
 
 #include <sys/poll.h>     // for poll( )
+#include <poll.h>         // for ppoll( )
+#include <time.h>         // for clock_gettime( )
+#include <netinet/udp.h>  // for UDP_SEGMENT, UDP_GRO
 }
 
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103   // linux 4.18
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104       // linux 5.0
+#endif
+#define UDP_MAX_SEGMENTS 64   // most segments the kernel takes in one send
+#define UDP_MAX_PAYLOAD 65507 // most bytes in one (super-)datagram
+#define UDP_MAX_GRO 65536     // most bytes UDP_GRO coalesces into one datagram
+
 #define NULL_SD -1        // means no socket descriptor
 
 class UdpSocket {
@@ -33,15 +47,57 @@ class UdpSocket {
   UdpSocket( const char* port );              // open an UDP socket with int port
   ~UdpSocket( );
   bool setDestAddress( const char* ); // set the IP addr given an IP name in char[]
+  bool setDestAddress( const char*, const char* ); // same, with a different dest port
   int pollRecvFrom( );           // check if this socket has data to receive
+  int waitRecv( long );          // wait up to long usec (< 0: forever) for data
+  void setSpin( long );          // let waitRecv( ) busy-poll up to long usec first
   int sendTo( char[], int );     // send a message in char[] whose size is int
   int recvFrom( char[], int );   // receive a message in char[] of int size
   int ackTo( char[], int );      // send an ack message in char[] of int size
+
+  // batches: count messages in msgs[] with lengths[] per system call
+  int sendBatch( char*[], int[], int );   // sendmmsg( ) all to the destination
+  int recvBatch( char*[], int[], int, struct sockaddr[] = NULL );
+                                          // recvmmsg( ) what is queued, no wait;
+                                          // fills lengths[] and optional senders
+  int ackBatch( char*[], int[], int, struct sockaddr[] = NULL );
+                                          // sendmmsg( ) to each sender, or to
+                                          // the last source received from
+
+  // segmentation offload: equal-sized messages laid out back to back in
+  // char[] travel the stack as one super-packet (UDP_SEGMENT on send,
+  // UDP_GRO on receive) and are split again only where they must be
+  bool setSegmentation( bool );  // turn offload on; false if not supported
+  bool segmentation( ) const { return offload; }
+  int sendSegments( char[], int, int );   // send int bytes as int-byte segments
+  int ackSegments( char[], int, int );    // same, to the last source
+  int recvSegments( char[], int, int& );  // receive up to int bytes; sets the
+                                          // segment size (the whole datagram
+                                          // if it was not coalesced); the
+                                          // segments beyond int bytes are held
+                                          // for the next receive
+  long truncations( ) const { return truncated; } // recvSegments( ) datagrams
+                                          // too big for the buffer and the
+                                          // held segments together
  private:
   const char* port;                      // this UDP port
   int sd;                        // this UDP socket descriptor
   struct sockaddr destAddr;   // a destination socket address for internet
   struct sockaddr srcAddr;       // a source socket address for internet
+  long spinLimit;                // most usec waitRecv( ) spins before blocking
+  long spinBudget;               // current spin, adapted to the traffic
+  bool offload;                  // UDP_SEGMENT / UDP_GRO in use
+  long truncated;                // datagrams that did not fit, held or not
+  vector<char> held;             // segments received but not handed out yet
+  int heldStart, heldEnd;        // what is left of them in held
+  int heldSegSize;               // their segment size
+  vector<struct mmsghdr> mmsgs;  // batch headers, reused between calls
+  vector<struct iovec> iovs;     // one per batched message
+  vector<struct sockaddr> srcAddrs; // senders of a received batch
+  int sendBatchTo( char*[], int[], int, struct sockaddr[], struct sockaddr* );
+  void prepareBatch( char*[], int[], int );
+  int sendSegmentsTo( char[], int, int, struct sockaddr* );
+  int recvHeld( char*[], int[], int );   // hand out held segments
 };  
 
 #endif  
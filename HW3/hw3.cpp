@@ -9,6 +9,8 @@ using namespace std;
 #define MAX 20000        // times of message transfer
 #define MAXWIN 30        // the maximum window size
 #define LOOP 10          // loop in test 4 and 5
+#define ACKEVERY 4       // delayed acks in test 6: ack every 4 packets
+#define ACKDELAY 100     // or 100 usec after the first unacked one
 
 // client packet sending functions
 void clientUnreliable( UdpSocket &sock, const int max, int message[] );
@@ -16,8 +18,10 @@ void clientUnreliable( UdpSocket &sock, const int max, int message[] );
 int clientStopWait( UdpSocket &sock, const int max, int message[] );
 int clientSlidingWindow( UdpSocket &sock, const int max, int message[], 
 			  int windowSize );
-//int clientSlowAIMD( UdpSocket &sock, const int max, int message[],
-//		     int windowSize, bool rttOn );
+int clientSelectiveRepeat( UdpSocket &sock, const int max, int message[],
+			   int windowSize, RttEstimator &rtt );
+int clientSlowAIMD( UdpSocket &sock, const int max, int message[],
+		     int windowSize, bool rttOn, vector<CwndSample> &trace );
 
 // server packet receiving fucntions
 void serverUnreliable( UdpSocket &sock, const int max, int message[] );
@@ -25,8 +29,12 @@ void serverUnreliable( UdpSocket &sock, const int max, int message[] );
 void serverReliable( UdpSocket &sock, const int max, int message[] );
 void serverEarlyRetrans( UdpSocket &sock, const int max, int message[], 
 			 int windowSize );
-//void serverEarlyRetrans( UdpSocket &sock, const int max, int message[], 
-//			 int windowSize, bool congestion );
+void serverSelectiveRepeat( UdpSocket &sock, const int max, int message[],
+			    int windowSize );
+int serverCongested( UdpSocket &sock, const int max, int message[],
+		     int windowSize );
+void serverEarlyRetrans( UdpSocket &sock, const int max, int message[], 
+			 int windowSize, DelayedAck &policy );
 
 enum myPartType { CLIENT, SERVER, ERROR } myPart;
 
@@ -35,6 +43,7 @@ int main( int argc, char *argv[] ) {
   UdpSocket sock( PORT );  // define a UDP socket
   
   myPart = ( argc == 1 ) ? SERVER : CLIENT;
+  Timer::useTsc( true );  // cheap timeouts when the TSC is a usable clock
 
   if ( argc != 1 && argc != 2 ) {
     cerr << "usage: " << argv[0] << " [serverIpName]" << endl;
@@ -52,6 +61,9 @@ int main( int argc, char *argv[] ) {
   cerr << "   1: unreliable test" << endl;
   cerr << "   2: stop-and-wait test" << endl;
   cerr << "   3: sliding windows" << endl;
+  cerr << "   4: selective repeat" << endl;
+  cerr << "   5: slow start and AIMD" << endl;
+  cerr << "   6: sliding windows with delayed acks" << endl;
   cerr << "--> ";
   cin >> testNumber;
 
@@ -68,22 +80,57 @@ int main( int argc, char *argv[] ) {
       cout << timer.lap( ) << endl;
       break;
     case 2:
+      {
+      RttEstimator rtt;                                        // RTT/RTO series
       timer.start( );                                          // start timer
-      retransmits = clientStopWait( sock, MAX, message );      // actual test
+      retransmits = clientStopWait( sock, MAX, message, rtt ); // actual test
       cerr << "Elasped time = ";                               // lap timer
       cout << timer.lap( ) << endl;
       cerr << "retransmits = " << retransmits << endl;
+      rtt.report( cerr );
+      }
       break;
     case 3:
+    case 6:
       for ( int windowSize = 1; windowSize <= MAXWIN; windowSize++ ) {
+		RttEstimator rtt;                                      // RTT/RTO series
 		timer.start( );                                        // start timer
 		retransmits =
-		clientSlidingWindow( sock, MAX, message, windowSize ); // actual test
+		clientSlidingWindow( sock, MAX, message, windowSize, rtt ); // actual test
 		cerr << "Window size = ";                              // lap timer
 		cout << windowSize << " ";
 		cerr << "Elasped time = "; 
 		cout << timer.lap( ) << endl;
 		cerr << "retransmits = " << retransmits << endl;
+		rtt.report( cerr, 3 );
+      }
+      break;
+    case 4:
+      for ( int windowSize = 1; windowSize <= MAXWIN; windowSize++ ) {
+		RttEstimator rtt;                                      // RTT/RTO series
+		timer.start( );                                        // start timer
+		retransmits =
+		clientSelectiveRepeat( sock, MAX, message, windowSize, rtt ); // actual test
+		cerr << "Window size = ";                              // lap timer
+		cout << windowSize << " ";
+		cerr << "Elasped time = "; 
+		cout << timer.lap( ) << endl;
+		cerr << "retransmits = " << retransmits << endl;
+		rtt.report( cerr, 3 );
+      }
+      break;
+    case 5:
+      for ( int rttOn = 0; rttOn <= 1; rttOn++ ) {
+		vector<CwndSample> trace;                              // cwnd per round trip
+		timer.start( );                                        // start timer
+		retransmits =
+		clientSlowAIMD( sock, MAX, message, MAXWIN, rttOn, trace ); // actual test
+		cerr << "rttOn = ";                                    // lap timer
+		cout << rttOn << " ";
+		cerr << "Elasped time = "; 
+		cout << timer.lap( ) << endl;
+		cerr << "retransmits = " << retransmits << endl;
+		printCwndTrace( cerr, trace );
       }
       break;
     default:
@@ -103,6 +150,22 @@ int main( int argc, char *argv[] ) {
       for ( int windowSize = 1; windowSize <= MAXWIN; windowSize++ )
 	serverEarlyRetrans( sock, MAX, message, windowSize );
       break;
+    case 4:
+      for ( int windowSize = 1; windowSize <= MAXWIN; windowSize++ )
+	serverSelectiveRepeat( sock, MAX, message, windowSize );
+      break;
+    case 5:
+      for ( int rttOn = 0; rttOn <= 1; rttOn++ )
+	serverCongested( sock, MAX, message, MAXWIN );
+      break;
+    case 6:
+      for ( int windowSize = 1; windowSize <= MAXWIN; windowSize++ ) {
+	DelayedAck policy( ACKEVERY, ACKDELAY );
+	serverEarlyRetrans( sock, MAX, message, windowSize, policy );
+	cerr << "Window size = " << windowSize << " acks = " << policy.acks
+	     << " saved = " << policy.saved( ) << endl;
+      }
+      break;
     default:
       cerr << "no such test case" << endl;
       break;
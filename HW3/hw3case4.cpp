@@ -9,6 +9,10 @@ using namespace std;
 #define MAX 20000        // times of message transfer
 #define MAXWIN 30        // the maximum window size
 #define LOOP 10          // loop in test 4 and 5
+#define LINKRATE 20000   // test 9 bottleneck: packets/sec (~234 Mbps),
+#define LINKQUEUE 16     // a 16-packet queue
+#define LINKDELAY 1000   // and 1000 usec of delay
+#define PACEBURST 4      // packets the pacer may send back to back
 
 // client packet sending functions
 void clientUnreliable( UdpSocket &sock, const int max, int message[] );
@@ -16,8 +20,14 @@ void clientUnreliable( UdpSocket &sock, const int max, int message[] );
 int clientStopWait( UdpSocket &sock, const int max, int message[] );
 int clientSlidingWindow( UdpSocket &sock, const int max, int message[], 
 			  int windowSize );
-//int clientSlowAIMD( UdpSocket &sock, const int max, int message[],
-//		     int windowSize, bool rttOn );
+int clientSelectiveRepeat( UdpSocket &sock, const int max, int message[],
+			   int windowSize, RttEstimator &rtt );
+int clientSack( UdpSocket &sock, const int max, int message[],
+		int windowSize, RttEstimator &rtt );
+int clientSlidingWindow( UdpSocket &sock, const int max, int message[],
+			 int windowSize, RttEstimator &rtt, Pacer &pacer );
+int clientSlowAIMD( UdpSocket &sock, const int max, int message[],
+		     int windowSize, bool rttOn, vector<CwndSample> &trace );
 
 // server packet receiving fucntions
 void serverUnreliable( UdpSocket &sock, const int max, int message[] );
@@ -27,8 +37,16 @@ void serverEarlyRetrans( UdpSocket &sock, const int max, int message[],
 			 int windowSize );
 void serverEarlyRetrans( UdpSocket &sock, const int max, int message[], 
 			 int windowSize, int dropPercentage );
-//void serverEarlyRetrans( UdpSocket &sock, const int max, int message[], 
-//			 int windowSize, bool congestion );
+void serverEarlyRetrans( UdpSocket &sock, const int max, int message[], 
+			 int windowSize, int dropPercentage, int ackDropPercentage );
+void serverSelectiveRepeat( UdpSocket &sock, const int max, int message[],
+			    int windowSize, int dropPercentage );
+void serverSack( UdpSocket &sock, const int max, int message[],
+		 int windowSize, int dropPercentage );
+int serverCongested( UdpSocket &sock, const int max, int message[],
+		     int windowSize );
+int serverBottleneck( UdpSocket &sock, const int max, int message[],
+		      int rate, int queue, long delay );
 
 enum myPartType { CLIENT, SERVER, ERROR } myPart;
 
@@ -38,6 +56,7 @@ int main( int argc, char *argv[] ) {
   UdpSocket sock( PORT );  // define a UDP socket
 
   myPart = ( argc == 1 ) ? SERVER : CLIENT;
+  Timer::useTsc( true );  // cheap timeouts when the TSC is a usable clock
 
   if ( argc != 1 && argc != 2 ) {
     cerr << "usage: " << argv[0] << " [serverIpName]" << endl;
@@ -56,6 +75,11 @@ int main( int argc, char *argv[] ) {
   cerr << "   2: stop-and-wait test" << endl;
   cerr << "   3: sliding windows" << endl;
   cerr << "   4: case 4" << endl;
+  cerr << "   5: case 4 with selective repeat" << endl;
+  cerr << "   6: slow start and AIMD" << endl;
+  cerr << "   7: case 4, what lost acks cost" << endl;
+  cerr << "   8: case 4 with SACK" << endl;
+  cerr << "   9: bottleneck link, unpaced and paced" << endl;
   cerr << "--> ";
   cin >> testNumber;
 
@@ -72,38 +96,147 @@ int main( int argc, char *argv[] ) {
       cout << timer.lap( ) << endl;
       break;
     case 2:
+      {
+      RttEstimator rtt;                                        // RTT/RTO series
       timer.start( );                                          // start timer
-      retransmits = clientStopWait( sock, MAX, message );      // actual test
+      retransmits = clientStopWait( sock, MAX, message, rtt ); // actual test
       cerr << "Elasped time = ";                               // lap timer
       cout << timer.lap( ) << endl;
       cerr << "retransmits = " << retransmits << endl;
+      rtt.report( cerr );
+      }
       break;
     case 3:
       for ( int windowSize = 1; windowSize <= MAXWIN; windowSize++ ) {
+		RttEstimator rtt;                                      // RTT/RTO series
 		timer.start( );                                        // start timer
 		retransmits =
-		clientSlidingWindow( sock, MAX, message, windowSize ); // actual test
+		clientSlidingWindow( sock, MAX, message, windowSize, rtt ); // actual test
 		cerr << "Window size = ";                              // lap timer
 		cout << windowSize << " ";
 		cerr << "Elasped time = "; 
 		cout << timer.lap( ) << endl;
 		cerr << "retransmits = " << retransmits << endl;
+		rtt.report( cerr, 3 );
       }
       break;
     case 4:
       for ( int windowSize = 1; windowSize <= MAXWIN; windowSize += 29 ) {
         for (int N = 0; N <= 10; N++) {
+		RttEstimator rtt;                                      // RTT/RTO series
+		timer.start( );                                        // start timer
+		retransmits =
+		clientSlidingWindow( sock, MAX, message, windowSize, rtt ); // actual test
+    cerr << "Drop percentage = ";
+    cout << N << " ";
+		cerr << "Elasped time = "; 
+		cout << timer.lap( ) << endl;
+		cerr << "retransmits = " << retransmits << endl;
+		rtt.report( cerr, 3 );
+        }
+      }
+      break;
+    case 5:
+      for ( int windowSize = 1; windowSize <= MAXWIN; windowSize += 29 ) {
+        for (int N = 0; N <= 10; N++) {
+		RttEstimator rtt;                                      // RTT/RTO series
 		timer.start( );                                        // start timer
 		retransmits =
-		clientSlidingWindow( sock, MAX, message, windowSize ); // actual test
+		clientSelectiveRepeat( sock, MAX, message, windowSize, rtt ); // actual test
     cerr << "Drop percentage = ";
     cout << N << " ";
 		cerr << "Elasped time = "; 
 		cout << timer.lap( ) << endl;
 		cerr << "retransmits = " << retransmits << endl;
+		rtt.report( cerr, 3 );
+        }
+      }
+      break;
+    case 6:
+      for ( int rttOn = 0; rttOn <= 1; rttOn++ ) {
+		vector<CwndSample> trace;                              // cwnd per round trip
+		timer.start( );                                        // start timer
+		retransmits =
+		clientSlowAIMD( sock, MAX, message, MAXWIN, rttOn, trace ); // actual test
+		cerr << "rttOn = ";                                    // lap timer
+		cout << rttOn << " ";
+		cerr << "Elasped time = "; 
+		cout << timer.lap( ) << endl;
+		cerr << "retransmits = " << retransmits << endl;
+		printCwndTrace( cerr, trace );
+      }
+      break;
+    case 7:
+      // each drop percentage twice: data packets dropped, then acks dropped
+      // at the same rate too. A later cumulative ack covers a lost one, so
+      // with room for more than one packet in transit lost acks should cost
+      // next to no retransmits; with a window of 1 every lost ack does.
+      for ( int windowSize = 1; windowSize <= MAXWIN; windowSize += 29 ) {
+        for (int N = 0; N <= 10; N++) {
+		int dataOnly = 0;                                      // retransmits, acks intact
+		for ( int acksDropped = 0; acksDropped <= 1; acksDropped++ ) {
+		  RttEstimator rtt;                                    // RTT/RTO series
+		  timer.start( );                                      // start timer
+		  retransmits =
+		  clientSlidingWindow( sock, MAX, message, windowSize, rtt ); // actual test
+    cerr << "Window size = ";
+    cout << windowSize << " ";
+    cerr << "Drop percentage = ";
+    cout << N << " ";
+		  cerr << "acks dropped = ";
+		  cout << acksDropped << " ";
+		  cerr << "Elasped time = "; 
+		  cout << timer.lap( ) << endl;
+		  cerr << "retransmits = " << retransmits << endl;
+		  rtt.report( cerr, 3 );
+		  if ( !acksDropped )
+		    dataOnly = retransmits;
+		}
+		cerr << "retransmits for lost acks = " << retransmits - dataOnly << endl;
+        }
+      }
+      break;
+    case 8:
+      for ( int windowSize = 1; windowSize <= MAXWIN; windowSize += 29 ) {
+        for (int N = 0; N <= 10; N++) {
+		RttEstimator rtt;                                      // RTT/RTO series
+		timer.start( );                                        // start timer
+		retransmits =
+		clientSack( sock, MAX, message, windowSize, rtt );     // actual test
+		long elapsed = timer.lap( );
+    cerr << "Drop percentage = ";
+    cout << N << " ";
+		cerr << "Elasped time = "; 
+		cout << elapsed << endl;
+		cerr << "retransmits = " << retransmits << endl;
+		cerr << "goodput = " << ( double )MAX * MSGSIZE * 8 / elapsed
+		     << " Mbps" << endl;
+		rtt.report( cerr, 3 );
         }
       }
       break;
+    case 9:
+      for ( int pacing = 0; pacing <= 2; pacing++ ) {
+		RttEstimator rtt;                                      // RTT/RTO series
+		Pacer pacer;                                           // 0: unpaced
+		if ( pacing == 1 )                                     // 1: follow the window
+		  pacer = Pacer( 0, PACEBURST, PACING_GAIN );
+		if ( pacing == 2 )                                     // 2: the link's rate
+		  pacer = Pacer( LINKRATE, PACEBURST );
+		timer.start( );                                        // start timer
+		retransmits =
+		clientSlidingWindow( sock, MAX, message, MAXWIN, rtt, pacer ); // actual test
+		long elapsed = timer.lap( );
+		cerr << "Pacing = ";
+		cout << pacing << " ";
+		cerr << "Elasped time = "; 
+		cout << elapsed << endl;
+		cerr << "retransmits = " << retransmits << endl;
+		cerr << "goodput = " << ( double )MAX * MSGSIZE * 8 / elapsed
+		     << " Mbps" << endl;
+		rtt.report( cerr, 3 );
+      }
+      break;
     default:
       cerr << "no such test case" << endl;
       break;
@@ -128,6 +261,39 @@ int main( int argc, char *argv[] ) {
         }
       }
       break;
+    case 5:
+      for ( int windowSize = 1; windowSize <= MAXWIN; windowSize += 29 ) {
+        for (int N = 0; N <= 10; N++) {
+	        serverSelectiveRepeat( sock, MAX, message, windowSize, N );
+        }
+      }
+      break;
+    case 6:
+      for ( int rttOn = 0; rttOn <= 1; rttOn++ )
+	serverCongested( sock, MAX, message, MAXWIN );
+      break;
+    case 7:
+      for ( int windowSize = 1; windowSize <= MAXWIN; windowSize += 29 ) {
+        for (int N = 0; N <= 10; N++) {
+	        serverEarlyRetrans( sock, MAX, message, windowSize, N );
+	        serverEarlyRetrans( sock, MAX, message, windowSize, N, N );
+        }
+      }
+      break;
+    case 8:
+      for ( int windowSize = 1; windowSize <= MAXWIN; windowSize += 29 ) {
+        for (int N = 0; N <= 10; N++) {
+	        serverSack( sock, MAX, message, windowSize, N );
+        }
+      }
+      break;
+    case 9:
+      for ( int pacing = 0; pacing <= 2; pacing++ ) {
+	int dropped = serverBottleneck( sock, MAX, message, LINKRATE, LINKQUEUE,
+					LINKDELAY );
+	cerr << "Pacing = " << pacing << " dropped at the queue = " << dropped << endl;
+      }
+      break;
     default:
       cerr << "no such test case" << endl;
       break;
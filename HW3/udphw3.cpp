@@ -2,40 +2,60 @@
 // CSS 432
 
 #include "udphw3.h"
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <deque>
 
-const int TIMEOUT = 1500;
+#define DUPACKS 3        // duplicate acks that count as a loss
+#define CONGESTED_RATE 20000 // packets/sec through serverCongested's router
+
+// The protocols block in UdpSocket::waitRecv( ) until data arrives or the
+// retransmission timer runs out, instead of spinning on pollRecvFrom( ).
+// The timeout comes from an RttEstimator: acks of packets sent only once
+// are RTT samples (Karn's rule) and every timeout backs the RTO off.
 
 // clientStopWait is client's side of reliable data transfer
 // sends packets and waits for corresponding ack until timeout
 // resend packet on timeout
 // returns the number of retransmitted packets
 int clientStopWait(UdpSocket& sock, const int max, int message[]) {
+  RttEstimator rtt;
+  return clientStopWait(sock, max, message, rtt);
+}
+
+int clientStopWait(UdpSocket& sock, const int max, int message[], RttEstimator& rtt) {
   int retransmissions = 0; // count retransmissions
+  int resent = -1;         // last sequence that was retransmitted
   Timer timer;             // timer to check for timeouts
 
   // transfer message[] max times
   for (int i = 0; i < max; i++) {
     message[0] = i;                                   // message[0] has a sequence #
     sock.sendTo( ( char * )message, MSGSIZE );        // udp message send
-    timer.start();                                    // start timer for this message
+    timer.setTimeout(rtt.rto());                      // start timer for this message
 
     // infinite loop to check for ACK
     for(;;) {
-      // if there is data to receive
-      if (sock.pollRecvFrom() > 0) {
+      // wait for data until the timer runs out
+      long remaining = timer.remaining();
+      if (remaining > 0 && sock.waitRecv(remaining) > 0) {
         sock.recvFrom((char *) message, MSGSIZE); // receive data
         // if ACK for current sequence number, then send next packet
         if (message[0] == i) {
+          if (resent != i)                            // Karn: sent once, so a clean sample
+            rtt.sample(timer.lap());
           break;
         }
+        continue;
       }
 
-      // if timeout, go back and resend it
-      if (timer.lap() > TIMEOUT) {
-        retransmissions++;
-        i--;
-        break;
-      }
+      // timeout, go back and resend it
+      retransmissions++;
+      rtt.backoff();
+      resent = i;
+      i--;
+      break;
     }
   }
 
@@ -46,68 +66,212 @@ int clientStopWait(UdpSocket& sock, const int max, int message[]) {
 // waits for packet and sends ack if packet has expected sequence #
 // ignores packets with wrong sequence #s
 void serverReliable(UdpSocket& sock, const int max, int message[]) {
+  DelayedAck policy; // ack every packet
+  serverReliable(sock, max, message, policy);
+}
+
+// same, with the acks of in order packets delayed by policy; a packet sent
+// again (its ack was too late for the client) is acked at once
+void serverReliable(UdpSocket& sock, const int max, int message[], DelayedAck& policy) {
+  int pending = 0;         // in order packets not acked yet
+  int last = -1;           // the latest of them
+  Timer timer;             // runs from the first of them
+
   // receive message[] max times
   for (int i = 0; i < max; i++) {
     // infinite loop to check if correct message arrived
     for(;;) {
-      if (sock.pollRecvFrom() > 0) { // if message arrived
+      long wait = (pending > 0) ? timer.remaining() : -1;
+      if (wait != 0 && sock.waitRecv(wait) > 0) { // block until a message arrives
         sock.recvFrom((char *) message, MSGSIZE); // receive message
+        policy.packets++;
         int sequence = message[0];                // sequence number
-        if (sequence <= i) {                       // if message in order
-          sock.ackTo((char *) &sequence, sizeof(sequence)); // send ack
-          i = sequence;                                     // synchronize client and server
-          break;                                                   // start waiting for next message
+        if (sequence == i) {                      // if message in order
+          last = i;
+          if (pending++ == 0)
+            timer.setTimeout(policy.delay);
+          if (pending >= policy.every || i == max - 1) {
+            sock.ackTo((char *) &last, sizeof(last)); // send ack
+            policy.acks++;
+            pending = 0;
+          }
+          break;                                  // start waiting for next message
         }
+        if (sequence < i) {                       // sent again
+          sock.ackTo((char *) &sequence, sizeof(sequence)); // send ack now
+          policy.acks++;
+          pending = 0;
+          i = sequence;                           // synchronize client and server
+          break;
+        }
+      } else if (pending > 0 && timer.expired()) { // delay is over: send ack
+        sock.ackTo((char *) &last, sizeof(last));
+        policy.acks++;
+        pending = 0;
       } // keep waiting for message of sequence i if message lost or wrong sequence
     }
   }
 }
 
+// Batch holds a window's worth of datagrams of size bytes, back to back, so
+// they can go through UdpSocket as one sendmmsg( ) / recvmmsg( ) batch or,
+// with segmentation offload on, as one super-packet
+struct Batch {
+  vector<int> data;      // windowSize datagrams back to back
+  vector<char *> msgs;   // start of each datagram
+  vector<int> lengths;   // length of each datagram
+  int size;              // bytes per datagram
+
+  Batch(int windowSize, int size) : data(windowSize * size / sizeof(int)),
+                                    msgs(windowSize), lengths(windowSize, size),
+                                    size(size) {
+    for (int j = 0; j < windowSize; j++)
+      msgs[j] = (char *) &data[j * size / sizeof(int)];
+  }
+  int *operator[](int j) { return (int *) msgs[j]; }
+
+  // send the first count datagrams to the destination, or as acks to the
+  // last source
+  int send(UdpSocket& sock, int count, bool ack) {
+    if (sock.segmentation())
+      return ack ? sock.ackSegments(msgs[0], count * size, size)
+                 : sock.sendSegments(msgs[0], count * size, size);
+    return ack ? sock.ackBatch(&msgs[0], &lengths[0], count)
+               : sock.sendBatch(&msgs[0], &lengths[0], count);
+  }
+
+  // receive up to count queued datagrams (a coalesced super-packet counts as
+  // what it holds, and UdpSocket keeps whatever it holds beyond count for
+  // the next recv); returns how many arrived, with their sizes in lengths
+  int recv(UdpSocket& sock, int count) {
+    fill(lengths.begin(), lengths.end(), size);
+    if (sock.segmentation()) {
+      int segSize;
+      int bytes = sock.recvSegments(msgs[0], min(count, (int) msgs.size()) * size, segSize);
+      return (bytes > 0 && segSize == size) ? bytes / size : 0;
+    }
+    return sock.recvBatch(&msgs[0], &lengths[0], count);
+  }
+};
+
 // clientSlidingWindow is client's side of Go-Back-N
-// sends number of packets based on windowSize
-// once windowSize packets sent, it starts a timer
-// waits for ACK for minimum sequence # in window before sliding window
-// resends entire window on timeout
-// returns number of retransmitted packets
+// sends number of packets based on windowSize, as one Batch
+// the timer starts when packets go out with none in transit, and restarts
+// whenever an ack slides the window
+// acks are cumulative: the server acks the most recent in-order packet, so
+// any ack at or above the minimum unacked sequence # slides the window past
+// it, and the freed part of the window is refilled in one burst;
+// all acks queued by then are taken in one Batch
+// resends entire window on timeout, or as soon as DUPACKS duplicate acks
+// show that the oldest packet was lost (fast retransmit). As in NewReno, the
+// packets in transit at that point keep producing duplicates, so no new
+// fast retransmit starts until an ack covers more than everything sent
+// before it (RFC 6582); duplicates of exactly that ack come from packets the
+// server already held when the window went back.
+// returns number of retransmitted packets once every packet is acked
 int clientSlidingWindow(UdpSocket& sock, const int max, int message[], int windowSize) {
+  RttEstimator rtt;
+  return clientSlidingWindow(sock, max, message, windowSize, rtt);
+}
+
+int clientSlidingWindow(UdpSocket& sock, const int max, int message[], int windowSize,
+                        RttEstimator& rtt) {
+  Pacer pacer; // unpaced
+  return clientSlidingWindow(sock, max, message, windowSize, rtt, pacer);
+}
+
+// same, with the window released no faster than pacer allows instead of in
+// bursts; a pacer without a fixed rate follows windowSize / SRTT (the RTO
+// stands in for the SRTT until the first sample). While the window has room
+// but no token, the client waits for acks only until the next token.
+int clientSlidingWindow(UdpSocket& sock, const int max, int message[], int windowSize,
+                        RttEstimator& rtt, Pacer& pacer) {
   int retransmissions = 0; // count retransmissions
   int minUnacked = 0;      // smallest sequence that hasn't been acked
-  int intransit = 0;       // number of packets in transit (unacked)
+  int next = 0;            // next sequence to send
+  int resent = -1;         // sequences up to this one were sent more than once
+  int dupAcks = 0;         // acks repeating minUnacked - 1
+  int recover = -1;        // in recovery until this sequence is acked
   Timer timer;             // timer to check for timeouts
+  Batch packets(windowSize, MSGSIZE);   // packets sent in one batch
+  Batch acks(windowSize, sizeof(int));  // acks received in one batch
+  vector<long long> sentAt(windowSize); // send time of each sequence in the window
 
   // transfer message[] max times
-  for (int i = 0; i < max; i++) {
-    // keep sending until number of packets in transit equals the window size
-    if (intransit < windowSize) {
-      message[0] = i;                                   // message[0] has a sequence #
-      sock.sendTo( ( char * )message, MSGSIZE );        // udp message send
-      intransit++;
-    }
-
-    // if number in transit is equal to window size
-    if (intransit == windowSize) {
-      timer.start();
-
-      // keep checking for data to receive or timeout
-      for(;;) {
-        // if there is data to receive
-        if (sock.pollRecvFrom() > 0) {
-          sock.recvFrom((char *) message, MSGSIZE);       // receive data
-          if (message[0] == minUnacked) {                 // if ack is for min unacked packet
-            minUnacked++;                                 // increment min unacked
-            intransit--;                                  // decrement in transit
-            break;                                        // break to send next in sequence
+  while (minUnacked < max) {
+    // fill the window: everything from next up to minUnacked + windowSize
+    // that the pacer lets go
+    pacer.follow(windowSize, rtt.samples() > 0 ? rtt.srtt() : rtt.rto());
+    int allowed = pacer.available(min(max, minUnacked + windowSize) - next);
+    if (allowed > 0 && next == minUnacked)             // none in transit
+      timer.setTimeout(rtt.rto());
+    int count = 0;
+    while (count < allowed) {
+      memcpy(packets[count], message, MSGSIZE);
+      packets[count][0] = next++;                       // message[0] has a sequence #
+      count++;
+    }
+    if (count > 0) {
+      packets.send(sock, count, false);                 // udp batch send
+      pacer.take(count);
+      long long now = Timer::now();
+      for (int j = 0; j < count; j++)
+        sentAt[packets[j][0] % windowSize] = now;
+    }
+
+    // wait for acks, or with room in the window for the pacer's next token
+    for(;;) {
+      bool room = next < max && next - minUnacked < windowSize;
+      long remaining = (next > minUnacked) ? timer.remaining() : pacer.wait();
+      long wait = room ? min(remaining, pacer.wait()) : remaining;
+      if (wait > 0 && sock.waitRecv(wait) > 0) {
+        int received = acks.recv(sock, windowSize);
+        long long now = Timer::now();
+        int oldest = minUnacked;
+        bool lost = false;                              // DUPACKS duplicates seen
+        for (int j = 0; j < received; j++) {
+          int ack = acks[j][0];
+          if (ack == minUnacked - 1) {                  // duplicate: minUnacked is missing
+            if (++dupAcks == DUPACKS && ack > recover)  // not a loss already recovering
+              lost = true;
+            continue;
           }
+          if (ack < minUnacked || ack >= next)          // old ack
+            continue;
+          if (ack > resent)                             // Karn: sent once, so a clean sample
+            rtt.sample((now - sentAt[ack % windowSize]) / 1000);
+          else                                          // a resent packet: no sample,
+            rtt.progress();                             // but the backoff is over
+          minUnacked = ack + 1;                         // everything up to ack arrived
+          dupAcks = 0;
         }
+        if (minUnacked > oldest)                        // the window slid
+          timer.setTimeout(rtt.rto());
 
-        // if timeout, go back n and resend them
-        if (timer.lap() > TIMEOUT) {
-          retransmissions += windowSize; // retransmit entire window
-          i = minUnacked;                // go back n
-          intransit = 0;                 // reset number in transit
-          break;                         // break to resend window
+        if (lost && minUnacked < next) {
+          // fast retransmit: go back n now instead of waiting for the timer
+          retransmissions += next - minUnacked;
+          resent = next - 1;
+          recover = next - 1;
+          next = minUnacked;
+          dupAcks = 0;
+          break;
         }
+        if (minUnacked == max || (next < max && next - minUnacked < windowSize))
+          break;                                        // room to send next in sequence
+        continue;
       }
+      if (room && (next == minUnacked || !timer.expired()))
+        break;                                          // the pacer lets the next one go
+
+      // timeout, go back n and resend them
+      retransmissions += next - minUnacked; // retransmit the window in transit
+      rtt.backoff();
+      resent = next - 1;             // everything sent so far goes out again
+      recover = next - 1;
+      next = minUnacked;             // go back n
+      dupAcks = 0;
+      break;                         // break to resend window
     }
   }
 
@@ -117,26 +281,519 @@ int clientSlidingWindow(UdpSocket& sock, const int max, int message[], int windo
 // serverEarlyRetrans is server's side of GBN
 // waits for in order packets and sends ACK
 // if out of order, then sends ACK for most recent in order packet
+// the packets queued when it wakes are taken in one Batch and answered
+// with one Batch of acks; message[] is not needed
 void serverEarlyRetrans(UdpSocket& sock, const int max, int message[], int windowSize) {
+  DelayedAck policy; // ack every packet
+  serverEarlyRetrans(sock, max, message, windowSize, policy);
+}
+
+// same, with the acks of in order packets delayed by policy; an out of
+// order packet is acked at once (a duplicate ack for the sender), which
+// also covers the in order packets still waiting. No more than a window's
+// worth of packets waits for an ack, or the sender would stall.
+void serverEarlyRetrans(UdpSocket& sock, const int max, int message[], int windowSize,
+                        DelayedAck& policy) {
   int recent = -1; // most recently acked message
+  int every = min(policy.every, windowSize);
+  int pending = 0; // in order packets not acked yet
+  Timer timer;     // runs from the first of them
+  Batch packets(windowSize, MSGSIZE);      // packets received in one batch
+  Batch acks(windowSize + 1, sizeof(int)); // acks sent in one batch
 
-  for (int i = 0; i < max; i++) {
-    for(;;) {
-      if (sock.pollRecvFrom() > 0) { // if message arrived
-        sock.recvFrom((char *) message, MSGSIZE);           // receive message
-        int sequence = message[0];                          // sequence number
+  while (recent < max - 1) {
+    long wait = (pending > 0) ? timer.remaining() : -1;
+    int received = 0;
+    if (wait != 0 && sock.waitRecv(wait) > 0) { // block until a message arrives
+      // never take more than the rest of this transfer needs, so packets
+      // of the next one stay queued
+      int count = min(windowSize, max - 1 - recent);
+      received = std::max(packets.recv(sock, count), 0);
+      policy.packets += received;
+    }
 
-        if (sequence == i) {                                // if message in order
-          i = sequence;                                       // synchronize with client
-          recent = i;                                         // update most recently acked message
+    int count = 0; // acks to send
+    for (int j = 0; j < received; j++) {
+      int sequence = packets[j][0];                     // sequence number
+      if (sequence == recent + 1) {                     // if message in order
+        recent = sequence;                              // update most recently acked message
+        if (pending++ == 0)
+          timer.setTimeout(policy.delay);
+        if (pending < every && recent < max - 1)
+          continue;                                     // the ack can wait
+      }
+      acks[count++][0] = recent;                        // ack for recent
+      pending = 0;
+    }
+    if (pending > 0 && timer.expired()) {               // delay is over
+      acks[count++][0] = recent;
+      pending = 0;
+    }
+    if (count > 0) {
+      acks.send(sock, count, true);
+      policy.acks += count;
+    }
+  }
+}
+
+// serverBottleneck is server's side of GBN behind an emulated bottleneck
+// link, like a slow hop with a shallow buffer: packets leave a drop-tail
+// queue of queue packets at rate packets per second and reach the server
+// delay usec later. A packet that finds the queue full is dropped;
+// the others are acked as in serverEarlyRetrans once they arrive.
+// returns the number of packets dropped at the queue
+int serverBottleneck(UdpSocket& sock, const int max, int message[], int rate, int queue,
+                     long delay) {
+  int recent = -1;                          // most recently acked message
+  int dropped = 0;
+  long long service = 1000000000LL / rate;  // nsec to put one packet on the link
+  long long linkFree = 0;                   // when the link has sent all it holds
+  deque<pair<long long, int>> link;         // arrival time and sequence of packets on the link
+
+  while (recent < max - 1) {
+    long wait = -1;                         // until the next arrival
+    if (!link.empty())
+      wait = std::max((link.front().first - Timer::now() + 999) / 1000, 0LL);
+    if (wait != 0 && sock.waitRecv(wait) > 0) {
+      sock.recvFrom((char *) message, MSGSIZE);     // receive message
+      long long now = Timer::now();
+      if (linkFree - now >= queue * service) {      // queue full
+        dropped++;
+      } else {
+        linkFree = std::max(linkFree, now) + service;
+        link.push_back(make_pair(linkFree + delay * 1000, message[0]));
+      }
+    }
+
+    long long now = Timer::now();
+    while (!link.empty() && link.front().first <= now) {
+      int sequence = link.front().second;           // sequence number
+      link.pop_front();
+      if (sequence == recent + 1)                   // if message in order
+        recent = sequence;                          // update most recently acked message
+      sock.ackTo((char *) &recent, sizeof(recent)); // send ack for recent
+    }
+  }
+  return dropped;
+}
+
+// serverCongested is server's side of GBN behind a router whose queue holds
+// windowSize / 2 packets, drained at CONGESTED_RATE packets per second:
+// serverBottleneck with no extra delay. A sender whose window outgrows the
+// queue (and the packet on the link) sees losses.
+// returns the number of packets dropped at the queue
+int serverCongested(UdpSocket& sock, const int max, int message[], int windowSize) {
+  return serverBottleneck(sock, max, message, CONGESTED_RATE, std::max(windowSize / 2, 1), 0);
+}
+
+// clientSelectiveRepeat is client's side of Selective Repeat
+// keeps up to windowSize packets in transit, each with its own timer
+// the server acks every packet individually; the window slides past
+// every acked packet at its bottom
+// on timeout, resends only the packets whose timers ran out
+// returns number of retransmitted packets
+int clientSelectiveRepeat(UdpSocket& sock, const int max, int message[], int windowSize) {
+  RttEstimator rtt;
+  return clientSelectiveRepeat(sock, max, message, windowSize, rtt);
+}
+
+int clientSelectiveRepeat(UdpSocket& sock, const int max, int message[], int windowSize,
+                          RttEstimator& rtt) {
+  int retransmissions = 0; // count retransmissions
+  int base = 0;            // smallest sequence that hasn't been acked
+  int next = 0;            // next sequence to send
+  Batch packets(windowSize, MSGSIZE);   // new packets sent in one batch
+  Batch acks(windowSize, sizeof(int));  // acks received in one batch
+  vector<long long> sentAt(windowSize); // per sequence in the window: last send time,
+  vector<bool> acked(windowSize);       // whether it was acked
+  vector<bool> resent(windowSize);      // and whether it was ever sent twice
+
+  while (base < max) {
+    // fill the window with new packets
+    int count = 0;
+    while (next < max && next - base < windowSize) {
+      memcpy(packets[count], message, MSGSIZE);
+      packets[count][0] = next;                         // message[0] has a sequence #
+      acked[next % windowSize] = false;
+      resent[next % windowSize] = false;
+      next++;
+      count++;
+    }
+    if (count > 0) {
+      packets.send(sock, count, false);                 // udp batch send
+      long long now = Timer::now();
+      for (int j = 0; j < count; j++)
+        sentAt[packets[j][0] % windowSize] = now;
+    }
+
+    // wait for acks until the earliest timer in the window runs out
+    long long oldest = LLONG_MAX;
+    for (int seq = base; seq < next; seq++)
+      if (!acked[seq % windowSize])
+        oldest = min(oldest, sentAt[seq % windowSize]);
+    long long left = oldest + rtt.rto() * 1000LL - Timer::now();
+    long remaining = (left > 0) ? (left + 999) / 1000 : 0;
+
+    if (remaining > 0 && sock.waitRecv(remaining) > 0) {
+      int received = acks.recv(sock, windowSize);
+      long long now = Timer::now();
+      for (int j = 0; j < received; j++) {
+        int ack = acks[j][0];
+        if (ack < base || ack >= next || acked[ack % windowSize])
+          continue;                                     // old or duplicate ack
+        acked[ack % windowSize] = true;
+        if (!resent[ack % windowSize])                  // Karn: sent once, so a clean sample
+          rtt.sample((now - sentAt[ack % windowSize]) / 1000);
+      }
+      while (base < next && acked[base % windowSize])   // slide the window
+        base++;
+      continue;
+    }
+
+    // timeout, resend just the packets whose timers ran out
+    long long now = Timer::now();
+    long long rto = rtt.rto() * 1000LL;
+    for (int seq = base; seq < next; seq++) {
+      int slot = seq % windowSize;
+      if (!acked[slot] && now - sentAt[slot] >= rto) {
+        message[0] = seq;
+        sock.sendTo((char *) message, MSGSIZE);         // udp message resend
+        sentAt[slot] = now;
+        resent[slot] = true;
+        retransmissions++;
+      }
+    }
+    rtt.backoff();
+  }
+
+  return retransmissions;
+}
+
+// ringReceiver is the receiving side of Selective Repeat and SACK
+// packets that arrive ahead of the next expected one wait in a ring of
+// windowSize slots until the gap is filled, then everything in order is
+// delivered and the window slides. A packet is dropped after it is read
+// with a dropPercentage chance, as if it had been lost on the way.
+// Selective Repeat acks every packet within the window individually (and
+// packets below it again, in case their acks were lost); with sack, every
+// packet is answered with a SACK of the whole ring instead.
+static void ringReceiver(UdpSocket& sock, const int max, int message[], int windowSize,
+                         int dropPercentage, bool sack) {
+  int base = 0;                                     // next sequence to deliver
+  vector<int> ring(windowSize * MSGSIZE / 4);       // packets received ahead of base
+  vector<bool> buffered(windowSize, false);         // which ring slots hold one
+  vector<int> ack(sack ? sackInts(windowSize) : 0); // SACK sent back
+
+  while (base < max) {
+    if (sock.waitRecv(-1) <= 0)                     // block until a message arrives
+      continue;
+    sock.recvFrom((char *) message, MSGSIZE);       // receive message
+    if (dropPercentage > 0 && std::rand() % 101 < dropPercentage)
+      continue;                                     // lost on the way
+
+    int sequence = message[0];                      // sequence number
+    if (sequence >= base + windowSize)              // beyond the window
+      continue;
+    if (!sack)
+      sock.ackTo((char *) &sequence, sizeof(sequence)); // ack this packet alone
+
+    if (sequence >= base) {
+      unsigned slot = (unsigned) sequence % windowSize; // sequence >= base >= 0
+      if (!buffered[slot]) {
+        memcpy(ring.data() + slot * (MSGSIZE / 4), message, MSGSIZE);
+        buffered[slot] = true;
+      }
+      while (base < max && buffered[base % windowSize]) { // deliver in order
+        buffered[base % windowSize] = false;
+        base++;
+      }
+    }
+
+    if (sack) {                                     // everything below base, and
+      fill(ack.begin(), ack.end(), 0);              // which packets above base + 1
+      ack[0] = base - 1;
+      for (int i = 0; base + 1 + i < base + windowSize; i++)
+        if (buffered[(base + 1 + i) % windowSize])
+          ack[1 + i / SACK_BITS] |= (int) (1u << (i % SACK_BITS));
+      sock.ackTo((char *) ack.data(), ack.size() * sizeof(int));
+    }
+  }
+}
+
+// serverSelectiveRepeat is server's side of Selective Repeat
+// acks every packet individually and reorders them in a ring
+void serverSelectiveRepeat(UdpSocket& sock, const int max, int message[], int windowSize) {
+  ringReceiver(sock, max, message, windowSize, 0, false);
+}
+
+// same, but a packet is dropped after it is read with a dropPercentage
+// chance, as if it had been lost on the way
+void serverSelectiveRepeat(UdpSocket& sock, const int max, int message[], int windowSize,
+                           int dropPercentage) {
+  ringReceiver(sock, max, message, windowSize, dropPercentage, false);
+}
+
+// serverSack is server's side of the SACK protocol
+// reorders packets in a ring like Selective Repeat, but answers every
+// packet with a SACK: the cumulative ack for everything delivered, as the
+// first int (what a GBN sender reads), then a bitmap of the packets held
+// in the ring above it
+void serverSack(UdpSocket& sock, const int max, int message[], int windowSize) {
+  ringReceiver(sock, max, message, windowSize, 0, true);
+}
+
+void serverSack(UdpSocket& sock, const int max, int message[], int windowSize,
+                int dropPercentage) {
+  ringReceiver(sock, max, message, windowSize, dropPercentage, true);
+}
+
+// clientSack is client's side of the SACK protocol
+// keeps a scoreboard of which packets in the window the server holds:
+// a SACK's cumulative ack slides the window, its bitmap marks the packets
+// above it. A hole with DUPACKS or more packets SACKed above it is lost and
+// resent at once, only once; other packets still unacked when their own
+// timer runs out are resent as in Selective Repeat.
+// returns number of retransmitted packets
+int clientSack(UdpSocket& sock, const int max, int message[], int windowSize) {
+  RttEstimator rtt;
+  return clientSack(sock, max, message, windowSize, rtt);
+}
+
+int clientSack(UdpSocket& sock, const int max, int message[], int windowSize,
+               RttEstimator& rtt) {
+  int retransmissions = 0; // count retransmissions
+  int base = 0;            // smallest sequence that hasn't been acked
+  int next = 0;            // next sequence to send
+  Batch packets(windowSize, MSGSIZE);          // new packets sent in one batch
+  int bits = (sackInts(windowSize) - 1) * SACK_BITS;   // SACK bitmap length
+  Batch acks(windowSize, sackInts(windowSize) * sizeof(int)); // SACKs received in one batch
+  vector<long long> sentAt(windowSize); // scoreboard, per sequence in the window:
+  vector<bool> sacked(windowSize);      // last send time, whether the server has it
+  vector<bool> resent(windowSize);      // and whether it was ever sent twice
+
+  while (base < max) {
+    // fill the window with new packets
+    int count = 0;
+    while (next < max && next - base < windowSize) {
+      memcpy(packets[count], message, MSGSIZE);
+      packets[count][0] = next;                         // message[0] has a sequence #
+      sacked[next % windowSize] = false;
+      resent[next % windowSize] = false;
+      next++;
+      count++;
+    }
+    if (count > 0) {
+      packets.send(sock, count, false);                 // udp batch send
+      long long now = Timer::now();
+      for (int j = 0; j < count; j++)
+        sentAt[packets[j][0] % windowSize] = now;
+    }
+
+    // wait for SACKs until the earliest timer in the window runs out
+    long long oldest = LLONG_MAX;
+    for (int seq = base; seq < next; seq++)
+      if (!sacked[seq % windowSize])
+        oldest = min(oldest, sentAt[seq % windowSize]);
+    long long left = oldest + rtt.rto() * 1000LL - Timer::now();
+    long remaining = (left > 0) ? (left + 999) / 1000 : 0;
+
+    if (remaining > 0 && sock.waitRecv(remaining) > 0) {
+      int received = acks.recv(sock, windowSize);
+      long long now = Timer::now();
+      for (int j = 0; j < received; j++) {
+        int cumulative = acks[j][0];                    // a plain int ack has no bitmap
+        bool hasBitmap = acks.lengths[j] == acks.size;
+        if (cumulative < base - 1 || cumulative >= next)
+          continue;                                     // old ack
+
+        // newly acked or SACKed packets; the latest one sent once is a sample
+        bool progress = cumulative >= base;
+        int latest = -1;
+        for (int seq = base; seq <= cumulative; seq++)
+          if (!sacked[seq % windowSize] && !resent[seq % windowSize])
+            latest = seq;
+        base = std::max(base, cumulative + 1);          // slide the window
+        for (int i = 0; hasBitmap && i < bits; i++) {
+          int seq = cumulative + 2 + i;
+          if (seq >= next)
+            break;
+          unsigned word = acks[j][1 + i / SACK_BITS];
+          if ((word >> (i % SACK_BITS) & 1) && !sacked[seq % windowSize]) {
+            sacked[seq % windowSize] = true;
+            progress = true;
+            if (!resent[seq % windowSize] && seq > latest)
+              latest = seq;
+          }
+        }
+        if (latest >= 0)                                // Karn: sent once, so a clean sample
+          rtt.sample((now - sentAt[latest % windowSize]) / 1000);
+        else if (progress)                              // only resent packets: no sample,
+          rtt.progress();                               // but the backoff is over
+      }
+
+      // resend every hole with DUPACKS packets SACKed above it, once
+      int above = 0;
+      for (int seq = next - 1; seq >= base; seq--) {
+        int slot = seq % windowSize;
+        if (sacked[slot]) {
+          above++;
+        } else if (above >= DUPACKS && !resent[slot]) {
+          message[0] = seq;
+          sock.sendTo((char *) message, MSGSIZE);       // udp message resend
+          sentAt[slot] = now;
+          resent[slot] = true;
+          retransmissions++;
         }
-        
-        sock.ackTo((char *) &recent, sizeof(recent)); // send ack for recent
+      }
+      continue;
+    }
+
+    // timeout, resend just the packets whose timers ran out
+    long long now = Timer::now();
+    long long rto = rtt.rto() * 1000LL;
+    for (int seq = base; seq < next; seq++) {
+      int slot = seq % windowSize;
+      if (!sacked[slot] && now - sentAt[slot] >= rto) {
+        message[0] = seq;
+        sock.sendTo((char *) message, MSGSIZE);         // udp message resend
+        sentAt[slot] = now;
+        resent[slot] = true;
+        retransmissions++;
+      }
+    }
+    rtt.backoff();
+  }
+
+  return retransmissions;
+}
+
+// clientSlowAIMD is client's side of Go-Back-N with congestion control
+// the window starts at one packet and grows by one per acked packet (slow
+// start) up to ssthresh, then by one per round trip (additive increase),
+// never beyond windowSize. A timeout halves ssthresh (multiplicative
+// decrease) and restarts slow start from one packet, going back to the
+// oldest unacked packet. Acks are cumulative: the GBN server acks the most
+// recent in-order packet.
+// the timer starts when packets go out with none in transit, and restarts
+// only when an ack slides the window, so acks that make no progress cannot
+// put a timeout off
+// rttOn times out after the RTO estimated from the measured RTT instead of
+// the fixed RTO_INITIAL
+// trace gets cwnd and ssthresh once per round trip
+// returns number of retransmitted packets
+int clientSlowAIMD(UdpSocket& sock, const int max, int message[], int windowSize, bool rttOn) {
+  vector<CwndSample> trace;
+  return clientSlowAIMD(sock, max, message, windowSize, rttOn, trace);
+}
+
+int clientSlowAIMD(UdpSocket& sock, const int max, int message[], int windowSize, bool rttOn,
+                   vector<CwndSample>& trace) {
+  int retransmissions = 0; // count retransmissions
+  int minUnacked = 0;      // smallest sequence that hasn't been acked
+  int next = 0;            // next sequence to send
+  int sent = 0;            // one past the highest sequence ever sent
+  int resent = -1;         // sequences up to this one were sent more than once
+  int roundEnd = -1;       // the round trip ends once this sequence is acked
+  double cwnd = 1;         // congestion window, in packets
+  double ssthresh = windowSize; // slow start threshold
+  RttEstimator rtt;        // RTO when rttOn
+  Timer timer;             // timer to check for timeouts
+  Batch packets(windowSize, MSGSIZE);   // packets sent in one batch
+  Batch acks(windowSize, sizeof(int));  // acks received in one batch
+  vector<long long> sentAt(windowSize); // send time of each sequence in the window
+
+  while (minUnacked < max) {
+    int window = std::min(windowSize, (int) cwnd);
 
-        if (recent == i) {                            // if recent is equal to expected sequence
-          break;                                        // break to wait for next sequence
+    // fill the window: everything from next up to minUnacked + window
+    bool idle = next == minUnacked;                     // none in transit
+    int count = 0;
+    while (next < max && next - minUnacked < window) {
+      memcpy(packets[count], message, MSGSIZE);
+      packets[count][0] = next++;                       // message[0] has a sequence #
+      count++;
+    }
+    if (count > 0) {
+      packets.send(sock, count, false);                 // udp batch send
+      sent = std::max(sent, next);
+      if (idle)
+        timer.setTimeout(rttOn ? rtt.rto() : RTO_INITIAL);
+      long long now = Timer::now();
+      for (int j = 0; j < count; j++)
+        sentAt[packets[j][0] % windowSize] = now;
+    }
+
+    // a new round trip starts with the first window sent after the last one
+    if (minUnacked > roundEnd) {
+      CwndSample sample = { (int) trace.size(), cwnd, ssthresh, rtt.rto() };
+      trace.push_back(sample);
+      roundEnd = next - 1;
+    }
+
+    // wait for data to receive until timeout
+    for(;;) {
+      long remaining = timer.remaining();
+      if (remaining > 0 && sock.waitRecv(remaining) > 0) {
+        int received = acks.recv(sock, windowSize);
+        long long now = Timer::now();
+        int newlyAcked = 0;
+        for (int j = 0; j < received; j++) {
+          int ack = acks[j][0];
+          if (ack < minUnacked || ack >= sent)          // old or duplicate ack
+            continue;
+          if (rttOn && ack > resent)                    // Karn: sent once, so a clean sample
+            rtt.sample((now - sentAt[ack % windowSize]) / 1000);
+          newlyAcked += ack + 1 - minUnacked;
+          minUnacked = ack + 1;                         // slide the window
         }
+        // after a go back n, acks of packets sent before it still count
+        next = std::max(next, minUnacked);
+        if (newlyAcked > 0)                             // the window slid
+          timer.setTimeout(rttOn ? rtt.rto() : RTO_INITIAL);
+
+        // grow the window for every packet acked
+        for (int j = 0; j < newlyAcked; j++)
+          cwnd += (cwnd < ssthresh) ? 1 : 1 / cwnd;
+        cwnd = std::min(cwnd, (double) windowSize);
+
+        if (minUnacked == max || next - minUnacked < std::min(windowSize, (int) cwnd))
+          break;                                        // room to send next in sequence
+        continue;
       }
+
+      // timeout: a loss, so back off and go back n
+      retransmissions += next - minUnacked;
+      ssthresh = std::max(cwnd / 2, 2.0);
+      cwnd = 1;
+      if (rttOn)
+        rtt.backoff();
+      resent = next - 1;       // everything sent so far goes out again
+      next = minUnacked;       // go back n
+      roundEnd = minUnacked - 1; // and start a new round trip with it
+      break;
     }
   }
-}
\ No newline at end of file
+
+  return retransmissions;
+}
+
+// print a clientSlowAIMD trace: the first rounds (slow start) one by one,
+// then evenly spaced rounds, rows lines in all
+void printCwndTrace(ostream& out, const vector<CwndSample>& trace, int rows) {
+  int n = trace.size();
+  if (n == 0)
+    return;
+  double sum = 0;
+  for (const CwndSample& s : trace)
+    sum += s.cwnd;
+  out << "rounds = " << n << " average cwnd = " << sum / n << endl;
+  out << "round cwnd ssthresh rto" << endl;
+
+  int head = std::min(n, rows / 2);
+  int step = std::max(1, (n - head + rows / 2 - 1) / std::max(rows / 2, 1));
+  for (int i = 0; i < n; i = (i < head) ? i + 1 : i + step) {
+    const CwndSample& s = trace[i];
+    out << "  " << s.round << " " << s.cwnd << " " << s.ssthresh << " " << s.rto << endl;
+  }
+}
+
@@ -3,11 +3,70 @@
 
 #include "UdpSocket.h"
 #include "Timer.h"
+#include "RttEstimator.h"
+#include "Pacer.h"
 #include "vector"
 
+// delayed acks for the servers: an in order packet's ack waits until every
+// in order packets are waiting for one, or until delay usec after the first
+// of them arrived, whichever comes first; a packet out of order is acked at
+// once. every = 1 acks every packet. The server counts the packets it took
+// and the acks it sent.
+struct DelayedAck {
+  int every;        // ack once this many in order packets wait
+  long delay;       // or this many usec after the first of them
+  long packets;     // packets received
+  long acks;        // acks sent
+  DelayedAck(int every = 1, long delay = 0) : every(every), delay(delay),
+                                             packets(0), acks(0) {}
+  long saved() const { return packets - acks; }
+};
+
 int clientStopWait(UdpSocket& sock, const int max, int message[]);
+int clientStopWait(UdpSocket& sock, const int max, int message[], RttEstimator& rtt);
 void serverReliable(UdpSocket& sock, const int max, int message[]);
+void serverReliable(UdpSocket& sock, const int max, int message[], DelayedAck& policy);
 int clientSlidingWindow(UdpSocket& sock, const int max, int message[], int windowSize);
+int clientSlidingWindow(UdpSocket& sock, const int max, int message[], int windowSize,
+                        RttEstimator& rtt);
+int clientSlidingWindow(UdpSocket& sock, const int max, int message[], int windowSize,
+                        RttEstimator& rtt, Pacer& pacer);
 void serverEarlyRetrans(UdpSocket& sock, const int max, int message[], int windowSize);
+void serverEarlyRetrans(UdpSocket& sock, const int max, int message[], int windowSize,
+                        DelayedAck& policy);
+int serverBottleneck(UdpSocket& sock, const int max, int message[], int rate, int queue,
+                     long delay);
+int serverCongested(UdpSocket& sock, const int max, int message[], int windowSize);
+int clientSelectiveRepeat(UdpSocket& sock, const int max, int message[], int windowSize);
+int clientSelectiveRepeat(UdpSocket& sock, const int max, int message[], int windowSize,
+                          RttEstimator& rtt);
+void serverSelectiveRepeat(UdpSocket& sock, const int max, int message[], int windowSize);
+void serverSelectiveRepeat(UdpSocket& sock, const int max, int message[], int windowSize,
+                           int dropPercentage);
+
+// a SACK: the cumulative ack, then a bitmap of SACK_BITS-bit words with
+// bit i set if packet cumulative + 2 + i is held by the server
+// (cumulative + 1 is the first one missing); there are enough words to
+// cover the window, so a SACK is sackInts(windowSize) ints
+#define SACK_BITS 32
+inline int sackInts(int windowSize) { return 1 + (windowSize + SACK_BITS - 1) / SACK_BITS; }
+int clientSack(UdpSocket& sock, const int max, int message[], int windowSize);
+int clientSack(UdpSocket& sock, const int max, int message[], int windowSize,
+               RttEstimator& rtt);
+void serverSack(UdpSocket& sock, const int max, int message[], int windowSize);
+void serverSack(UdpSocket& sock, const int max, int message[], int windowSize,
+                int dropPercentage);
+
+// one round trip of clientSlowAIMD
+struct CwndSample {
+  int round;        // round trip number
+  double cwnd;      // congestion window at its start, in packets
+  double ssthresh;  // slow start threshold
+  long rto;         // estimated RTO in usec (used only with rttOn)
+};
+int clientSlowAIMD(UdpSocket& sock, const int max, int message[], int windowSize, bool rttOn);
+int clientSlowAIMD(UdpSocket& sock, const int max, int message[], int windowSize, bool rttOn,
+                   vector<CwndSample>& trace);
+void printCwndTrace(ostream& out, const vector<CwndSample>& trace, int rows = 40);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,122 @@
+// Microbenchmark harness
+
+#include "Bench.h"
+
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <atomic>
+#include <time.h>
+
+static atomic<long> allocations( 0 ); // operator new calls, all threads
+
+// Count every heap allocation made by the program -----------------------------
+void *operator new( size_t size ) {
+  allocations.fetch_add( 1, memory_order_relaxed );
+  void *p = malloc( size ? size : 1 );
+  if ( p == nullptr ) throw bad_alloc( );
+  return p;
+}
+
+void operator delete( void *p ) noexcept {
+  free( p );
+}
+
+void operator delete( void *p, size_t ) noexcept {
+  free( p );
+}
+
+long allocationCount( ) {
+  return allocations.load( memory_order_relaxed );
+}
+
+// Monotonic time in nanoseconds ----------------------------------------------
+static long long nowNs( ) {
+  struct timespec ts;
+  clock_gettime( CLOCK_MONOTONIC, &ts );
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Constructor: parse command line options -------------------------------------
+Bench::Bench( int argc, char *argv[] ) : dir( "." ), minMs( 500 ) {
+  for ( int i = 1; i < argc; i++ ) {
+    string arg = argv[i];
+    if ( i + 1 >= argc ) {
+      cerr << "missing value for " << arg << endl;
+      exit( -1 );
+    }
+    if ( arg == "--json" ) jsonPath = argv[++i];
+    else if ( arg == "--label" ) label = argv[++i];
+    else if ( arg == "--filter" ) filter = argv[++i];
+    else if ( arg == "--min-ms" ) minMs = atol( argv[++i] );
+    else if ( arg == "--dir" ) dir = argv[++i];
+    else {
+      cerr << "usage: " << argv[0] << " [--json file] [--label tag]"
+           << " [--filter substring] [--min-ms ms] [--dir repoRoot]" << endl;
+      exit( -1 );
+    }
+  }
+}
+
+// Run one benchmark -----------------------------------------------------------
+void Bench::run( const string &name, long opsPerCall, long bytesPerOp,
+                 function<void( )> body ) {
+  if ( !filter.empty( ) && name.find( filter ) == string::npos )
+    return;
+
+  body( ); // warm-up: page in code, fill caches, open files
+
+  long calls = 0;
+  long allocStart = allocationCount( );
+  long long start = nowNs( );
+  long long elapsed = 0;
+  do {
+    body( );
+    calls++;
+    elapsed = nowNs( ) - start;
+  } while ( elapsed < minMs * 1000000LL );
+  long allocs = allocationCount( ) - allocStart;
+
+  BenchResult r;
+  r.name = name;
+  r.ops = calls * opsPerCall;
+  r.nsPerOp = ( double )elapsed / r.ops;
+  r.allocsPerOp = ( double )allocs / r.ops;
+  r.bytesPerOp = bytesPerOp;
+  r.mbPerSec = bytesPerOp > 0 ? ( double )bytesPerOp * r.ops / ( elapsed / 1e3 ) : 0;
+  results.push_back( r );
+
+  // printf rather than cout: benchmarks may silence cout for chatty code
+  printf( "%-36s %10ld ops %12.1f ns/op %8.2f allocs/op %10.2f MB/s\n",
+          r.name.c_str( ), r.ops, r.nsPerOp, r.allocsPerOp, r.mbPerSec );
+  fflush( stdout );
+}
+
+// Write results as JSON -------------------------------------------------------
+int Bench::finish( ) {
+  if ( jsonPath.empty( ) )
+    return 0;
+
+  ofstream out( jsonPath );
+  if ( !out ) {
+    fprintf( stderr, "cannot write %s\n", jsonPath.c_str( ) );
+    return -1;
+  }
+
+  out << "{\n  \"label\": \"" << label << "\",\n  \"benchmarks\": [\n";
+  for ( size_t i = 0; i < results.size( ); i++ ) {
+    const BenchResult &r = results[i];
+    char entry[320];
+    snprintf( entry, sizeof( entry ),
+              "    {\"name\": \"%s\", \"ops\": %ld, \"ns_per_op\": %.3f, "
+              "\"allocs_per_op\": %.4f, \"bytes_per_op\": %ld, \"mb_per_sec\": %.3f}",
+              r.name.c_str( ), r.ops, r.nsPerOp, r.allocsPerOp, r.bytesPerOp, r.mbPerSec );
+    out << entry << ( i + 1 < results.size( ) ? ",\n" : "\n" );
+  }
+  out << "  ]\n}\n";
+  printf( "wrote %s\n", jsonPath.c_str( ) );
+  return 0;
+}
@@ -0,0 +1,44 @@
+// Microbenchmark harness
+// Times a body repeatedly until a minimum run time is reached and reports
+// ns/op, heap allocations/op and throughput. Results can be written as JSON
+// so runs can be compared from commit to commit.
+
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+#include <string>
+#include <vector>
+#include <functional>
+
+using namespace std;
+
+// number of operator new calls since program start (all threads)
+long allocationCount( );
+
+struct BenchResult {
+  string name;          // benchmark name
+  long ops;             // operations measured
+  double nsPerOp;       // wall time per operation
+  double allocsPerOp;   // operator new calls per operation
+  long bytesPerOp;      // payload bytes moved per operation (0 if n/a)
+  double mbPerSec;      // bytesPerOp * ops / time, in MB/s
+};
+
+class Bench {
+ public:
+  Bench( int argc, char *argv[] );   // parse --json, --label, --filter, --min-ms
+  // time body( ) until minMs has elapsed; each call performs opsPerCall ops
+  void run( const string &name, long opsPerCall, long bytesPerOp,
+            function<void( )> body );
+  int finish( );                     // print the table and write the JSON file
+  const string &dataDir( ) const { return dir; }
+ private:
+  vector<BenchResult> results;
+  string jsonPath;                   // where to write JSON, empty for none
+  string label;                      // free-form tag, e.g. a commit hash
+  string filter;                     // only run names containing this
+  string dir;                        // working directory for file-based cases
+  long minMs;                        // minimum measured time per benchmark
+};
+
+#endif
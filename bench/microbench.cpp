@@ -0,0 +1,221 @@
+// Microbenchmarks for the hot paths of HW2 and HW3
+// HW2 request parsing and response building run over in-memory socketpairs,
+// the HW3 Go-Back-N and Selective Repeat pairs run over loopback with the
+// server on a thread. The run fails if a lossless Go-Back-N transfer resends
+// more than HW3_RETRANSMIT_LIMIT of its packets.
+// usage: microbench [--json file] [--label tag] [--filter substring]
+//                   [--min-ms ms] [--dir repoRoot]
+
+#include "Bench.h"
+#include "../HW3/udphw3.h"
+#include "../HW3/udphw3case4.h"
+
+#include <iostream>
+#include <string>
+#include <thread>
+#include <cstring>
+#include <cstdlib>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace std;
+
+// HW2/Server.cpp and HW2/retriever_testing/Retriever.cpp (built with NO_MAIN)
+string parseRequest(int sd);
+string prepareResponse(string filePath);
+int parseHeader(int sd, string& status, int& bufsize);
+
+#define CLIENT_PORT "23470"  // loopback ports for the HW3 pair
+#define SERVER_PORT "23471"
+#define HW3_MESSAGES 2000    // messages per Go-Back-N transfer
+#define HW3_SPIN_USEC 20     // waitRecv( ) spin for the spinning variants
+#define HW3_ACK_EVERY 4      // delayed acks for the delack variant
+#define HW3_ACK_DELAY 100    // usec
+#define HW3_CASE4_MESSAGES 20000 // messages per transfer, as in hw3case4
+#define HW3_RETRANSMIT_LIMIT 0.01 // lossless case4 transfer: retransmits per message
+
+// discards everything written to it; the HW2 code logs every request to cout
+class NullBuffer : public streambuf {
+ protected:
+  int overflow( int c ) { return c; }
+};
+
+// writes text into one end of a socketpair and hands back the other end
+struct Pipe {
+  int sd[2];
+  Pipe( ) { socketpair( AF_UNIX, SOCK_STREAM, 0, sd ); }
+  ~Pipe( ) { close( sd[0] ); close( sd[1] ); }
+  int feed( const string &text ) {
+    write( sd[0], text.data( ), text.size( ) );
+    return sd[1];
+  }
+};
+
+static bool retransmitsOk = true; // the lossless transfer stayed within the limit
+
+// empty whatever is still queued on sock (stray acks or retransmissions)
+static void drain( UdpSocket &sock, int message[] ) {
+  while ( sock.pollRecvFrom( ) > 0 )
+    sock.recvFrom( ( char * )message, MSGSIZE );
+}
+
+// a lossless transfer should resend no more than the odd window after a
+// spurious timeout; duplicate acks mistaken for a new loss resend thousands
+static void checkRetransmits( const string &name, long retransmits, long transfers,
+                              int messages ) {
+  if ( transfers == 0 )  // filtered out
+    return;
+  double perTransfer = ( double )retransmits / transfers;
+  cerr << name << ": retransmits per transfer = " << perTransfer << endl;
+  if ( perTransfer > HW3_RETRANSMIT_LIMIT * messages ) {
+    cerr << name << ": more than " << HW3_RETRANSMIT_LIMIT * messages
+         << " on a lossless path" << endl;
+    retransmitsOk = false;
+  }
+}
+
+// HW2 web server ---------------------------------------------------------------
+static void benchServer( Bench &bench ) {
+  string get = "GET /index.html HTTP/1.1\r\nHost: localhost\r\n\r\n";
+  string secret = "GET /SecretFile.html HTTP/1.1\r\nHost: localhost\r\n\r\n";
+  long pageSize = prepareResponse( "./index.html" ).size( );
+
+  bench.run( "hw2/parseRequest/index", 1, pageSize, [&]( ) {
+    Pipe p;
+    parseRequest( p.feed( get ) );
+  } );
+  bench.run( "hw2/parseRequest/unauthorized", 1, 0, [&]( ) {
+    Pipe p;
+    parseRequest( p.feed( secret ) );
+  } );
+  bench.run( "hw2/prepareResponse/index", 1, pageSize, [&]( ) {
+    prepareResponse( "./index.html" );
+  } );
+  bench.run( "hw2/prepareResponse/notFound", 1, 0, [&]( ) {
+    prepareResponse( "./missing.html" );
+  } );
+}
+
+// HW2 retriever ------------------------------------------------------------------
+static void benchRetriever( Bench &bench ) {
+  string header = "HTTP/1.1 200 OK\r\nContent-Type: text/html\r\n"
+                  "Content-Length: 1024\r\n\r\n";
+
+  bench.run( "hw2/parseHeader", 1, header.size( ), [&]( ) {
+    Pipe p;
+    string status;
+    int bufsize;
+    parseHeader( p.feed( header ), status, bufsize );
+  } );
+}
+
+// HW3 Go-Back-N over loopback ----------------------------------------------------
+static void benchSlidingWindow( Bench &bench ) {
+  UdpSocket client( CLIENT_PORT );
+  UdpSocket server( SERVER_PORT );
+  client.setDestAddress( "127.0.0.1", SERVER_PORT );
+  int clientMsg[MSGSIZE/4], serverMsg[MSGSIZE/4];
+  memset( clientMsg, 0, sizeof( clientMsg ) );
+  Timer::useTsc( true );  // as in hw3: timeouts off the TSC where usable
+
+  // each window blocking in waitRecv( ), then with a short adaptive spin first
+  int windows[] = { 1, 30 };
+  int spins[] = { 0, HW3_SPIN_USEC };
+  for ( int spin : spins ) {
+    client.setSpin( spin );
+    server.setSpin( spin );
+    string suffix = spin ? "/spin" + to_string( spin ) : "";
+    for ( int windowSize : windows ) {
+      bench.run( "hw3/slidingWindow/w" + to_string( windowSize ) + suffix, HW3_MESSAGES, MSGSIZE, [&]( ) {
+        thread receiver( [&]( ) {
+          serverEarlyRetrans( server, HW3_MESSAGES, serverMsg, windowSize );
+        } );
+        clientSlidingWindow( client, HW3_MESSAGES, clientMsg, windowSize );
+        receiver.join( );
+        drain( client, clientMsg );
+        drain( server, serverMsg );
+      } );
+    }
+  }
+  client.setSpin( 0 );
+  server.setSpin( 0 );
+
+  // Go-Back-N with the server acking every HW3_ACK_EVERY packets
+  bench.run( "hw3/slidingWindow/w30/delack" + to_string( HW3_ACK_EVERY ), HW3_MESSAGES, MSGSIZE, [&]( ) {
+    thread receiver( [&]( ) {
+      DelayedAck policy( HW3_ACK_EVERY, HW3_ACK_DELAY );
+      serverEarlyRetrans( server, HW3_MESSAGES, serverMsg, 30, policy );
+    } );
+    clientSlidingWindow( client, HW3_MESSAGES, clientMsg, 30 );
+    receiver.join( );
+    drain( client, clientMsg );
+    drain( server, serverMsg );
+  } );
+
+  // the hw3case4 server at 0% drop: one packet per read, each acked on its
+  // own, so every packet resent after a go back draws a duplicate ack;
+  // loopback drops nothing, so this must stay near zero retransmits
+  long retransmits = 0, transfers = 0;
+  bench.run( "hw3/slidingWindow/w30/case4", HW3_CASE4_MESSAGES, MSGSIZE, [&]( ) {
+    thread receiver( [&]( ) {
+      serverEarlyRetrans( server, HW3_CASE4_MESSAGES, serverMsg, 30, 0 );
+    } );
+    retransmits += clientSlidingWindow( client, HW3_CASE4_MESSAGES, clientMsg, 30 );
+    transfers++;
+    receiver.join( );
+    drain( client, clientMsg );
+    drain( server, serverMsg );
+  } );
+  checkRetransmits( "hw3/slidingWindow/w30/case4", retransmits, transfers, HW3_CASE4_MESSAGES );
+
+  // Selective Repeat on the same pair, for comparison with Go-Back-N
+  bench.run( "hw3/selectiveRepeat/w30", HW3_MESSAGES, MSGSIZE, [&]( ) {
+    thread receiver( [&]( ) {
+      serverSelectiveRepeat( server, HW3_MESSAGES, serverMsg, 30 );
+    } );
+    clientSelectiveRepeat( client, HW3_MESSAGES, clientMsg, 30 );
+    receiver.join( );
+    drain( client, clientMsg );
+    drain( server, serverMsg );
+  } );
+
+  // the full window again as UDP_SEGMENT super-packets, coalesced by UDP_GRO
+  if ( !client.setSegmentation( true ) || !server.setSegmentation( true ) ) {
+    cerr << "hw3/slidingWindow/w30/gso: no UDP_GRO in this kernel, skipped" << endl;
+    return;
+  }
+  bench.run( "hw3/slidingWindow/w30/gso", HW3_MESSAGES, MSGSIZE, [&]( ) {
+    thread receiver( [&]( ) {
+      serverEarlyRetrans( server, HW3_MESSAGES, serverMsg, 30 );
+    } );
+    clientSlidingWindow( client, HW3_MESSAGES, clientMsg, 30 );
+    receiver.join( );
+    drain( client, clientMsg );
+    drain( server, serverMsg );
+  } );
+  cerr << "hw3/slidingWindow/w30/gso: truncated super-packets = "
+       << server.truncations( ) + client.truncations( ) << endl;
+  client.setSegmentation( false );
+  server.setSegmentation( false );
+}
+
+int main( int argc, char *argv[] ) {
+  Bench bench( argc, argv );
+
+  // the web server resolves request paths relative to HW2/
+  if ( chdir( ( bench.dataDir( ) + "/HW2" ).c_str( ) ) != 0 ) {
+    cerr << "cannot find " << bench.dataDir( ) << "/HW2, pass --dir repoRoot" << endl;
+    return -1;
+  }
+
+  NullBuffer null;
+  streambuf *console = cout.rdbuf( &null ); // silence request logging
+
+  benchServer( bench );
+  benchRetriever( bench );
+  benchSlidingWindow( bench );
+
+  cout.rdbuf( console );
+  int status = bench.finish( );
+  return retransmitsOk ? status : -1;
+}
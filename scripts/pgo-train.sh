@@ -0,0 +1,52 @@
+#!/bin/bash
+# Training run for the instrumented (make pgo) build.
+# Drives each program with the same load the demos use so the profile
+# reflects the hot paths: HW1 write strategies, HW2 request handling and,
+# through the microbenchmarks, the HW3 protocol loops.
+# usage: scripts/pgo-train.sh <build dir>
+set -e
+
+BUILD=$(cd "${1:-build/pgo}" && pwd)
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+HW1_PORT=${HW1_PORT:-23461}
+HW2_PORT=${HW2_PORT:-23462}
+REPS=${REPS:-5000}
+
+# stop a server with SIGTERM and wait so it exits through main and flushes
+# its profile
+stopServer() {
+    kill -TERM "$1" 2>/dev/null || true
+    wait "$1" 2>/dev/null || true
+}
+
+# HW1: every write type over a few buffer splits ---------------------------
+"$BUILD/HW1/server" "$HW1_PORT" "$REPS" > /dev/null &
+SERVER=$!
+sleep 0.5
+for split in "15 100" "30 50" "100 15" "500 3"; do
+    set -- $split
+    for type in 1 2 3 4 5 6; do
+        "$BUILD/HW1/client" "$HW1_PORT" localhost "$REPS" "$1" "$2" "$type"
+    done
+done
+stopServer "$SERVER"
+
+# HW2: the retriever demo requests against the web server ------------------
+cd "$ROOT/HW2"
+"$BUILD/HW2/server" "$HW2_PORT" > /dev/null &
+SERVER=$!
+sleep 0.5
+WORK=$(mktemp -d)
+cd "$WORK"
+for i in $(seq 1 200); do
+    for path in /test.txt /fake.txt /SecretFile.html ../upper.txt test.txt \
+                /files/test2.txt; do
+        "$BUILD/HW2/retriever" "$HW2_PORT" localhost "$path" > /dev/null
+    done
+done
+cd "$ROOT"
+rm -rf "$WORK"
+stopServer "$SERVER"
+
+# microbenchmarks: HW2 parsing over socketpairs, HW3 Go-Back-N on loopback --
+"$BUILD/bench/microbench" --dir "$ROOT" --min-ms 200 > /dev/null